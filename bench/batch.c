@@ -0,0 +1,175 @@
+/*
+ * Copyright (c) 2026, agent
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* batch • documents per second over many 200 byte to 2KB comments */
+/*	one parser per document, one reused context, then the batch driver
+ *	as threads are added; batch outputs are checked against the serial
+ *	ones */
+
+#include "markdown.h"
+#include "html.h"
+#include "buffer.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define EXTENSIONS (MKDEXT_AUTOLINK | MKDEXT_FENCED_CODE | MKDEXT_STRIKETHROUGH)
+
+/* a comment of about size bytes */
+static void
+put_comment(struct buf *doc, size_t size, unsigned int n)
+{
+	static const char *parts[] = {
+		"Thanks for the *quick* fix, this works on my machine now.\n",
+		"See http://example.com/issues/%u for the **details**.\n",
+		"\n- the `--force` flag\n- the [docs](http://example.com/%u)\n\n",
+		"> I think this is a ~~bug~~ feature\n\n",
+		"```\nmake clean && make\n```\n\n",
+		"Could you add a test for issue #%u? _Thanks_ &amp; cheers.\n",
+	};
+
+	for (; doc->size < size; ++n)
+		bufprintf(doc, parts[n % 6], n);
+}
+
+/* a growing byte array past the 16MB ceiling of a libc buffer */
+struct blob {
+	uint8_t *data;
+	size_t size, asize;
+};
+
+static void
+blob_put(struct blob *blob, const uint8_t *data, size_t size)
+{
+	if (blob->size + size > blob->asize) {
+		blob->asize = (blob->size + size) * 2;
+		blob->data = realloc(blob->data, blob->asize);
+	}
+
+	memcpy(blob->data + blob->size, data, size);
+	blob->size += size;
+}
+
+static void
+report(const char *name, size_t count, size_t bytes, double t)
+{
+	printf("%-14s %12.0f %10.1f\n", name, count / t, bytes / t / 1e6);
+}
+
+int
+main(int argc, char **argv)
+{
+	struct sd_callbacks callbacks;
+	struct html_renderopt options;
+	struct sd_config *cfg;
+	struct sd_markdown *md;
+	struct sd_slice *docs, *outputs;
+	struct blob all = { NULL, 0, 0 }, serial = { NULL, 0, 0 };
+	struct buf *doc, *ob;
+	size_t count = 100000, bytes, i, *offsets;
+	unsigned int threads, max_threads = 16;
+	double t;
+
+	if (argc > 1)
+		count = strtoul(argv[1], NULL, 10);
+	if (argc > 2)
+		max_threads = (unsigned int)strtoul(argv[2], NULL, 10);
+
+	sdhtml_renderer(&callbacks, &options, 0);
+	cfg = sd_config_new(EXTENSIONS, 16, &callbacks);
+
+	/* every document back to back in a single array */
+	doc = bufnew(4096);
+	docs = malloc(count * sizeof(struct sd_slice));
+	outputs = malloc(count * sizeof(struct sd_slice));
+	offsets = malloc((count + 1) * sizeof(size_t));
+
+	srand(42);
+	for (i = 0; i < count; ++i) {
+		doc->size = 0;
+		put_comment(doc, 200 + rand() % 1800, (unsigned int)i);
+		offsets[i] = all.size;
+		blob_put(&all, doc->data, doc->size);
+	}
+	offsets[count] = bytes = all.size;
+
+	for (i = 0; i < count; ++i) {
+		docs[i].data = all.data + offsets[i];
+		docs[i].size = offsets[i + 1] - offsets[i];
+	}
+
+	printf("%zu documents, %zu bytes\n", count, bytes);
+	printf("%-14s %12s %10s\n", "mode", "docs/s", "MB/s");
+
+	ob = bufnew(64);
+
+	/* a parser set up and torn down for every document */
+	t = now();
+	for (i = 0; i < count; ++i) {
+		md = sd_markdown_new(EXTENSIONS, 16, &callbacks, &options);
+		ob->size = 0;
+		sd_markdown_render(ob, docs[i].data, docs[i].size, md);
+		sd_markdown_free(md);
+	}
+	report("new-per-doc", count, bytes, now() - t);
+
+	/* one context rendering them all */
+	md = sd_markdown_new_context(cfg, &options);
+	t = now();
+	for (i = 0; i < count; ++i) {
+		ob->size = 0;
+		sd_markdown_render(ob, docs[i].data, docs[i].size, md);
+		blob_put(&serial, ob->data, ob->size);
+	}
+	report("one-context", count, bytes, now() - t);
+	sd_markdown_free(md);
+
+	for (threads = 1; threads <= max_threads; threads *= 2) {
+		/* all of the outputs are kept for the comparison below */
+		struct sd_batch *batch = sd_batch_new(cfg, &options, threads, (size_t)-1);
+		char name[32];
+		size_t pos = 0;
+		int same = 1;
+
+		t = now();
+		sd_batch_render(batch, docs, outputs, NULL, count);
+		t = now() - t;
+
+		for (i = 0; i < count && same; ++i) {
+			same = pos + outputs[i].size <= serial.size &&
+				memcmp(outputs[i].data, serial.data + pos, outputs[i].size) == 0;
+			pos += outputs[i].size;
+		}
+
+		snprintf(name, sizeof(name), "batch-%u%s", threads, same ? "" : "!");
+		report(name, count, bytes, t);
+		sd_batch_free(batch);
+	}
+
+	sd_config_free(cfg);
+	bufrelease(doc);
+	bufrelease(ob);
+	free(all.data);
+	free(serial.data);
+	free(docs);
+	free(outputs);
+	free(offsets);
+	return 0;
+}
+
+/* vim: set filetype=c: */
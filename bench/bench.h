@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2026, agent
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef BENCH_H__
+#define BENCH_H__
+
+#include "buffer.h"
+
+#include <stddef.h>
+
+/* now • monotonic time, in seconds */
+double now(void);
+
+/* put_prose • plain paragraphs, a little emphasis */
+void put_prose(struct buf *doc, size_t size);
+
+/* put_links • inline links, references and autolinks on every line */
+void put_links(struct buf *doc, size_t size);
+
+/* put_tables • tables with inline markup in the cells */
+void put_tables(struct buf *doc, size_t size);
+
+/* put_nested • lists, then quotes, nested depth levels down */
+void put_nested(struct buf *doc, size_t size, unsigned int depth);
+
+/* put_html • HTML blocks and inline tags */
+void put_html(struct buf *doc, size_t size);
+
+/* put_emphasis • unmatched emphasis openers, several short paragraphs of them */
+void put_emphasis(struct buf *doc, size_t size);
+
+/* put_manual • a manual: sections with most of the block types */
+void put_manual(struct buf *doc, size_t size);
+
+/* put_section • section number n of a generated manual, one at a time */
+void put_section(struct buf *doc, unsigned int n);
+
+#endif
+
+/* vim: set filetype=c: */
@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2026, agent
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* bufgrow • appends a large document to buffers under each growth policy */
+
+#include "buffer.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define APPEND_UNIT 64
+
+static size_t reallocs;
+
+static void *
+counting_realloc(void *opaque, void *ptr, size_t old_size, size_t new_size)
+{
+	reallocs++;
+	return realloc(ptr, new_size);
+}
+
+static void
+counting_free(void *opaque, void *ptr, size_t size)
+{
+	free(ptr);
+}
+
+int
+main(int argc, char **argv)
+{
+	static const char *names[] = { "linear", "double", "half", "capped" };
+	static const struct buf_allocator counting = { counting_realloc, counting_free, NULL };
+	static const uint8_t chunk[] = "Lorem ipsum dolor sit amet.\n";
+	size_t sizes[] = { 64 * 1024, 1024 * 1024, 8 * 1024 * 1024 };
+	size_t s, round, rounds = 5;
+	int policy;
+
+	if (argc > 1)
+		rounds = strtoul(argv[1], NULL, 10);
+
+	printf("%-8s %10s %10s %12s %10s\n", "policy", "bytes", "reallocs", "asize", "ms");
+
+	for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+		for (policy = BUF_GROW_LINEAR; policy <= BUF_GROW_CAPPED; ++policy) {
+			struct buf *ob = NULL;
+			double start, best = 0.0;
+
+			for (round = 0; round < rounds; ++round) {
+				bufrelease(ob);
+				reallocs = 0;
+
+				ob = bufnew_with(APPEND_UNIT, &counting);
+				ob->growth = policy;
+
+				start = now();
+				while (ob->size < sizes[s])
+					bufput(ob, chunk, sizeof(chunk) - 1);
+				start = now() - start;
+
+				if (round == 0 || start < best)
+					best = start;
+			}
+
+			printf("%-8s %10zu %10zu %12zu %10.3f\n",
+				names[policy], ob->size, reallocs, ob->asize, best * 1e3);
+			bufrelease(ob);
+		}
+	}
+
+	return 0;
+}
+
+/* vim: set filetype=c: */
@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) 2026, agent
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* cache • page views of READMEs, rendered every time or through a cache */
+/*	a few pages get most of the views; then wiki pages, all different
+ *	but sharing most of their blocks, through the block cache. Every
+ *	output of the caches is compared against a fresh render */
+
+#include "markdown.h"
+#include "html.h"
+#include "buffer.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define EXTENSIONS (MKDEXT_TABLES | MKDEXT_FENCED_CODE | MKDEXT_AUTOLINK)
+#define PAGES 1000
+
+/* a README of a few KB */
+static void
+put_readme(struct buf *doc, unsigned int n)
+{
+	unsigned int i, sections = 3 + n % 8;
+
+	bufprintf(doc, "# project-%u\n\nA *small* library for **parsing** things, see <http://example.com/%u>.\n\n", n, n);
+
+	for (i = 0; i < sections; ++i) {
+		bufprintf(doc, "## Usage %u\n\n", i);
+		bufputs(doc,
+			"Install it with `make install`, then link against `-lproject`:\n\n"
+			"```c\n#include <project.h>\n\nint main(void) { return project_run(); }\n```\n\n"
+			"- fast, with _no_ allocations in the hot path\n"
+			"- portable to [every platform](http://example.com/platforms)\n\n"
+			"Option | Default\n------ | -------\nthreads | 1\nlimit | 16\n\n");
+	}
+}
+
+/* a wiki page: the same navigation table and license around its own text */
+static void
+put_wiki(struct buf *doc, unsigned int n)
+{
+	unsigned int i;
+
+	bufputs(doc,
+		"Home | Guides | API | FAQ\n"
+		"---- | ------ | --- | ---\n"
+		"[home](/) | [guides](/guides) | [api](/api) | [faq](/faq)\n\n");
+	bufprintf(doc, "# Page %u\n\nThis page covers *topic* %u, see [the index][index].\n\n", n, n);
+
+	for (i = 0; i < 4; ++i)
+		bufputs(doc,
+			"## Parameters\n\n"
+			"Name | Type | Description\n"
+			"---- | ---- | -----------\n"
+			"`limit` | int | largest number of **items** returned\n"
+			"`offset` | int | items skipped _before_ the first one\n"
+			"`sort` | string | field the items are sorted on\n\n");
+
+	bufputs(doc,
+		"> Copyright (c) the authors. Permission to use, copy, modify, and\n"
+		"> distribute this documentation for any purpose is hereby granted.\n\n"
+		"[index]: /wiki/index \"Index\"\n");
+}
+
+/* renders every wiki page, through the block cache or not */
+static double
+run_wiki(struct buf **wiki, size_t count, struct sd_markdown *md, struct buf *ob, struct buf *all)
+{
+	double t = now();
+	size_t i;
+
+	for (i = 0; i < count; ++i) {
+		ob->size = 0;
+		sd_markdown_render(ob, wiki[i]->data, wiki[i]->size, md);
+		if (all)
+			bufput(all, ob->data, ob->size);
+	}
+
+	return now() - t;
+}
+
+int
+main(int argc, char **argv)
+{
+	struct sd_callbacks callbacks;
+	struct html_renderopt options;
+	struct sd_markdown *md;
+	struct sd_cache *cache;
+	struct sd_cache_stats stats;
+	struct buf *pages[PAGES], *wiki[PAGES], *ob, *check, *all_plain, *all_cached;
+	size_t views = 200000, budget = 4, i, bytes = 0, wiki_bytes = 0, *order;
+	double plain, cached;
+	int same = 1;
+
+	if (argc > 1)
+		views = strtoul(argv[1], NULL, 10);
+	if (argc > 2)
+		budget = strtoul(argv[2], NULL, 10);
+
+	sdhtml_renderer(&callbacks, &options, 0);
+	md = sd_markdown_new(EXTENSIONS, 16, &callbacks, &options);
+	cache = sd_cache_new(budget * 1024 * 1024);
+
+	for (i = 0; i < PAGES; ++i) {
+		pages[i] = bufnew(1024);
+		put_readme(pages[i], (unsigned int)i);
+	}
+
+	/* nine views out of ten go to the first hundred pages */
+	order = malloc(views * sizeof(size_t));
+	srand(42);
+	for (i = 0; i < views; ++i) {
+		order[i] = rand() % 10 ? rand() % (PAGES / 10) : rand() % PAGES;
+		bytes += pages[order[i]]->size;
+	}
+
+	ob = bufnew(64 * 1024);
+	check = bufnew(64 * 1024);
+
+	plain = now();
+	for (i = 0; i < views; ++i) {
+		ob->size = 0;
+		sd_markdown_render(ob, pages[order[i]]->data, pages[order[i]]->size, md);
+	}
+	plain = now() - plain;
+
+	cached = now();
+	for (i = 0; i < views; ++i) {
+		ob->size = 0;
+		sd_cache_render(cache, ob, pages[order[i]]->data, pages[order[i]]->size, md, options.flags);
+	}
+	cached = now() - cached;
+
+	for (i = 0; i < PAGES && same; ++i) {
+		ob->size = check->size = 0;
+		sd_cache_render(cache, ob, pages[i]->data, pages[i]->size, md, options.flags);
+		sd_markdown_render(check, pages[i]->data, pages[i]->size, md);
+		same = ob->size == check->size && memcmp(ob->data, check->data, ob->size) == 0;
+	}
+
+	sd_cache_stats(cache, &stats);
+
+	printf("%zu views, %zu bytes, %zuMB cache\n", views, bytes, budget);
+	printf("%-8s %12s %10s\n", "render", "views/s", "MB/s");
+	printf("%-8s %12.0f %10.1f\n", "plain", views / plain, bytes / plain / 1e6);
+	printf("%-8s %12.0f %10.1f%s\n", "cached", views / cached, bytes / cached / 1e6,
+		same ? "" : "  output differs");
+	printf("hits %zu, misses %zu, evictions %zu, entries %zu, bytes %zu\n",
+		stats.hits, stats.misses, stats.evictions, stats.entries, stats.bytes);
+
+	/* every wiki page is new to the document cache */
+	for (i = 0; i < PAGES; ++i) {
+		wiki[i] = bufnew(1024);
+		put_wiki(wiki[i], (unsigned int)i);
+		wiki_bytes += wiki[i]->size;
+	}
+
+	all_plain = bufnew(64 * 1024);
+	all_cached = bufnew(64 * 1024);
+
+	plain = run_wiki(wiki, PAGES, md, ob, all_plain);
+	sd_markdown_use_cache(md, cache, options.flags);
+	run_wiki(wiki, PAGES, md, ob, all_cached);
+	cached = run_wiki(wiki, PAGES, md, ob, NULL);
+
+	same = all_plain->size == all_cached->size &&
+		memcmp(all_plain->data, all_cached->data, all_plain->size) == 0;
+
+	sd_cache_stats(cache, &stats);
+
+	printf("\n%d wiki pages, %zu bytes\n", PAGES, wiki_bytes);
+	printf("%-8s %12s %10s\n", "render", "pages/s", "MB/s");
+	printf("%-8s %12.0f %10.1f\n", "plain", PAGES / plain, wiki_bytes / plain / 1e6);
+	printf("%-8s %12.0f %10.1f%s\n", "blocks", PAGES / cached, wiki_bytes / cached / 1e6,
+		same ? "" : "  output differs");
+	printf("block hits %zu, misses %zu\n", stats.block_hits, stats.block_misses);
+
+	for (i = 0; i < PAGES; ++i) {
+		bufrelease(pages[i]);
+		bufrelease(wiki[i]);
+	}
+
+	sd_cache_free(cache);
+	sd_markdown_free(md);
+	bufrelease(ob);
+	bufrelease(check);
+	bufrelease(all_plain);
+	bufrelease(all_cached);
+	free(order);
+	return 0;
+}
+
+/* vim: set filetype=c: */
@@ -0,0 +1,171 @@
+/*
+ * Copyright (c) 2026, agent
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* corpus • the timer and the document generators shared by the benchmarks */
+
+#include "bench.h"
+
+#include <time.h>
+
+double
+now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void
+put_prose(struct buf *doc, size_t size)
+{
+	unsigned int n;
+
+	for (n = 0; doc->size < size; ++n)
+		bufprintf(doc,
+			"Paragraph %u runs on for a while with plain words, a bit of *emphasis*\n"
+			"and then some more words, wrapped like a hand-written document would\n"
+			"be, until it finally comes to an end after the third line.\n\n", n);
+}
+
+void
+put_links(struct buf *doc, size_t size)
+{
+	unsigned int n;
+
+	for (n = 0; doc->size < size; ++n)
+		bufprintf(doc,
+			"See [the page](http://example.com/%u \"Page %u\"), [this one][r%u], "
+			"<http://example.com/a/%u>, www.example.com/%u and mail@example.com.\n"
+			"[r%u]: http://example.com/ref/%u\n\n", n, n, n, n, n, n, n);
+}
+
+void
+put_tables(struct buf *doc, size_t size)
+{
+	unsigned int n;
+
+	for (n = 0; doc->size < size; ++n)
+		bufprintf(doc,
+			"Name | Value | Notes\n"
+			":--- | ----: | :---:\n"
+			"`alpha%u` | %u | *first*\n"
+			"beta | 2 | ~~old~~\n"
+			"gamma | 3 | [link](http://example.com/%u)\n"
+			"delta | 4 | plain\n\n", n, n, n);
+}
+
+void
+put_nested(struct buf *doc, size_t size, unsigned int depth)
+{
+	unsigned int n, d, i;
+
+	for (n = 0; doc->size < size; ++n) {
+		for (d = 0; d < depth; ++d) {
+			for (i = 0; i < d; ++i)
+				bufputs(doc, "    ");
+			bufprintf(doc, "- item %u at *level %u*\n", n, d);
+		}
+		bufputc(doc, '\n');
+
+		for (d = 1; d <= depth; ++d) {
+			for (i = 0; i < d; ++i)
+				bufputs(doc, "> ");
+			bufprintf(doc, "quote %u at level %u\n", n, d);
+		}
+		bufputc(doc, '\n');
+	}
+}
+
+void
+put_html(struct buf *doc, size_t size)
+{
+	unsigned int n;
+
+	for (n = 0; doc->size < size; ++n)
+		bufprintf(doc,
+			"<div class=\"note\" id=\"n%u\">\n<p>Raw <b>HTML</b> block</p>\n</div>\n\n"
+			"Text with <span class=\"x\">inline</span> tags, <!-- a comment -->\n"
+			"and <a href=\"http://example.com/%u\">a link</a>.\n\n"
+			"<table>\n<tr><td>%u</td></tr>\n</table>\n\n", n, n, n);
+}
+
+void
+put_emphasis(struct buf *doc, size_t size)
+{
+	static const char *patterns[] = { "*a ", "_a ", "**a ", "***a ", "a *b", "~~a " };
+	unsigned int n;
+	size_t end;
+
+	for (n = 0; doc->size < size; ++n) {
+		end = doc->size + 16 * 1024;
+		while (doc->size < end)
+			bufputs(doc, patterns[n % 6]);
+		bufputs(doc, "\n\n");
+	}
+}
+
+void
+put_manual(struct buf *doc, size_t size)
+{
+	unsigned int n;
+
+	for (n = 0; doc->size < size; ++n)
+		bufprintf(doc,
+			"## Section %u\n\n"
+			"Paragraph %u has *some* **emphasis**, a [link](http://example.com/%u) "
+			"and `code`, then plain words until the end of the line.\n\n"
+			"- the *first* item\n- the `second` one\n    - nested, with a [link][%u]\n\n"
+			"Option | Default\n------ | -------\n`threads` | 1\n**limit** | 16\n\n"
+			"```c\nint main(void) { return %u; }\n```\n\n"
+			"> quoted <em>text</em>\n\n"
+			"[%u]: http://example.com/ref/%u \"Reference\"\n\n", n, n, n, n, n, n, n);
+}
+
+void
+put_section(struct buf *doc, unsigned int n)
+{
+	bufprintf(doc, "## Section %u\n\n", n);
+	bufprintf(doc,
+		"The *option* number %u sets the **limit** of `calls` made before\n"
+		"the [index][ref%u] is rebuilt, see <http://example.com/%u> and\n"
+		"the [manual](http://example.com/manual#%u \"Manual\").\n\n", n, n % 64, n, n);
+	bufputs(doc,
+		"- first item, with some _emphasis_\n"
+		"- second item\n\n"
+		"  continued after a blank line\n"
+		"- third item\n\n");
+	bufputs(doc,
+		"```c\n"
+		"int main(void)\n"
+		"{\n\n"
+		"\treturn 0;\n"
+		"}\n"
+		"```\n\n");
+	bufputs(doc,
+		"Name | Value | Notes\n"
+		"---- | ----- | -----\n"
+		"alpha | 1 | ~~old~~\n"
+		"beta | 2 | new^2\n\n");
+	bufputs(doc,
+		"> Quoted text that goes on\n"
+		"over two lines.\n\n"
+		"<div class=\"note\">\n\n"
+		"Raw HTML note\n\n"
+		"</div>\n\n");
+	bufprintf(doc, "[ref%u]: http://example.com/ref/%u \"Reference\"\n\n", n % 64, n);
+}
+
+/* vim: set filetype=c: */
@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2026, agent
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* emphasis • render time of unmatched emphasis runs as the input doubles */
+/*	linear parsing keeps ns/byte flat down each column */
+
+#include "markdown.h"
+#include "html.h"
+#include "buffer.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int
+main(int argc, char **argv)
+{
+	static const char *patterns[] = {
+		"*a ", "_a ", "**a ", "***a ", "a *b", "~~a ",
+	};
+
+	struct sd_callbacks callbacks;
+	struct html_renderopt options;
+	struct sd_markdown *md;
+	struct buf *doc, *ob;
+	size_t p, size, max_size = 256 * 1024;
+
+	if (argc > 1)
+		max_size = strtoul(argv[1], NULL, 10);
+
+	sdhtml_renderer(&callbacks, &options, 0);
+	md = sd_markdown_new(MKDEXT_STRIKETHROUGH, 16, &callbacks, &options);
+
+	doc = bufnew(1024);
+	ob = bufnew(1024);
+
+	printf("%-8s %10s %10s %10s\n", "pattern", "bytes", "ms", "ns/byte");
+
+	for (p = 0; p < sizeof(patterns) / sizeof(patterns[0]); ++p) {
+		for (size = 4 * 1024; size <= max_size; size *= 2) {
+			double start;
+
+			/* a single paragraph of repeated unmatched openers */
+			doc->size = 0;
+			while (doc->size < size)
+				bufputs(doc, patterns[p]);
+			bufputc(doc, '\n');
+
+			ob->size = 0;
+			start = now();
+			sd_markdown_render(ob, doc->data, doc->size, md);
+			start = now() - start;
+
+			printf("%-8s %10zu %10.3f %10.1f\n",
+				patterns[p], doc->size, start * 1e3, start * 1e9 / doc->size);
+		}
+	}
+
+	sd_markdown_free(md);
+	bufrelease(doc);
+	bufrelease(ob);
+	return 0;
+}
+
+/* vim: set filetype=c: */
@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2026, agent
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* escape • houdini escaping throughput on escape-free and escape-dense text */
+/*	build with -DSUNDOWN_NO_SIMD to compare against the byte loops */
+
+#include "buffer.h"
+#include "houdini.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INPUT_SIZE (1024 * 1024)
+
+typedef void (*escape_fn)(struct buf *ob, const uint8_t *src, size_t size);
+
+static void
+escape_html_plain(struct buf *ob, const uint8_t *src, size_t size)
+{
+	houdini_escape_html0(ob, src, size, 0);
+}
+
+/* fill • repeats a pattern over the whole input */
+static void
+fill(struct buf *in, const char *pattern)
+{
+	size_t len = strlen(pattern);
+
+	in->size = 0;
+	while (in->size + len <= INPUT_SIZE)
+		bufput(in, pattern, len);
+}
+
+int
+main(int argc, char **argv)
+{
+	static const struct {
+		const char *name;
+		escape_fn escape;
+	} escapers[] = {
+		{ "html", escape_html_plain },
+		{ "html-secure", houdini_escape_html },
+		{ "href", houdini_escape_href },
+	};
+
+	static const struct {
+		const char *name;
+		const char *pattern;
+	} inputs[] = {
+		{ "free", "The quick brown fox jumps over the lazy dog, twice. " },
+		{ "sparse", "Fish & chips, said the \"chef\" to the crowd at 5pm. " },
+		{ "dense", "<a href='/x'>&</a>\"<>\"" },
+		{ "url", "https://example.com/docs/api/v2/index.html?page=2&sort=name#top " },
+	};
+
+	struct buf *in, *ob;
+	size_t e, s, round, rounds = 20;
+
+	if (argc > 1)
+		rounds = strtoul(argv[1], NULL, 10);
+
+	in = bufnew(1024);
+	ob = bufnew(1024);
+
+	printf("%-12s %-8s %10s %10s %10s\n", "escape", "input", "in", "out", "MB/s");
+
+	for (e = 0; e < sizeof(escapers) / sizeof(escapers[0]); ++e) {
+		for (s = 0; s < sizeof(inputs) / sizeof(inputs[0]); ++s) {
+			double start, best = 0.0;
+
+			fill(in, inputs[s].pattern);
+
+			for (round = 0; round < rounds; ++round) {
+				ob->size = 0;
+				start = now();
+				escapers[e].escape(ob, in->data, in->size);
+				start = now() - start;
+
+				if (round == 0 || start < best)
+					best = start;
+			}
+
+			printf("%-12s %-8s %10zu %10zu %10.1f\n",
+				escapers[e].name, inputs[s].name, in->size, ob->size,
+				in->size / best / (1024 * 1024));
+		}
+	}
+
+	bufrelease(in);
+	bufrelease(ob);
+	return 0;
+}
+
+/* vim: set filetype=c: */
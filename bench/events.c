@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2026, agent
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* events • the HTML renderer through callbacks and through events */
+/*	flat prose, then quotes and lists nested a few levels deep, where
+ *	the callbacks copy every level into its parent; the outputs of the
+ *	two are compared */
+
+#include "markdown.h"
+#include "html.h"
+#include "buffer.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define EXTENSIONS (MKDEXT_TABLES | MKDEXT_FENCED_CODE | MKDEXT_AUTOLINK | MKDEXT_STRIKETHROUGH)
+
+static double
+run(struct sd_markdown *md, struct buf *doc, struct buf *ob, int rounds)
+{
+	double t = now();
+	int i;
+
+	for (i = 0; i < rounds; ++i) {
+		ob->size = 0;
+		sd_markdown_render(ob, doc->data, doc->size, md);
+	}
+
+	return (now() - t) / rounds;
+}
+
+int
+main(int argc, char **argv)
+{
+	struct sd_callbacks callbacks;
+	struct sd_events events;
+	struct html_renderopt cb_options, ev_options;
+	struct sd_config *cb_cfg, *ev_cfg;
+	struct sd_markdown *cb_md, *ev_md;
+	struct buf *doc, *cb_out, *ev_out;
+	size_t size = 4 * 1024 * 1024;
+	int rounds = 10, kind;
+
+	if (argc > 1)
+		size = strtoul(argv[1], NULL, 10) * 1024;
+	if (argc > 2)
+		rounds = atoi(argv[2]);
+
+	sdhtml_renderer(&callbacks, &cb_options, 0);
+	sdhtml_events(&events, &ev_options, 0);
+	cb_cfg = sd_config_new(EXTENSIONS, 64, &callbacks);
+	ev_cfg = sd_config_new_events(EXTENSIONS, 64, &events);
+	cb_md = sd_markdown_new_context(cb_cfg, &cb_options);
+	ev_md = sd_markdown_new_context(ev_cfg, &ev_options);
+
+	doc = bufnew(64 * 1024);
+	cb_out = bufnew(64 * 1024);
+	ev_out = bufnew(64 * 1024);
+
+	printf("%-10s %12s %12s\n", "document", "callbacks", "events");
+
+	for (kind = 0; kind < 4; ++kind) {
+		static const char *names[] = { "prose", "nested-3", "nested-6", "nested-9" };
+		double cb_time, ev_time;
+		int same;
+
+		doc->size = 0;
+		if (kind == 0)
+			put_prose(doc, size);
+		else
+			put_nested(doc, size, kind * 3);
+
+		ev_time = run(ev_md, doc, ev_out, rounds);
+		cb_time = run(cb_md, doc, cb_out, rounds);
+
+		same = cb_out->size == ev_out->size &&
+			memcmp(cb_out->data, ev_out->data, cb_out->size) == 0;
+
+		printf("%-10s %9.1fMB/s %9.1fMB/s%s\n", names[kind],
+			doc->size / cb_time / 1e6, doc->size / ev_time / 1e6,
+			same ? "" : "  output differs");
+	}
+
+	sd_markdown_free(cb_md);
+	sd_markdown_free(ev_md);
+	sd_config_free(cb_cfg);
+	sd_config_free(ev_cfg);
+	bufrelease(doc);
+	bufrelease(cb_out);
+	bufrelease(ev_out);
+	return 0;
+}
+
+/* vim: set filetype=c: */
@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2026, agent
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* incremental • keystroke latency of a live preview on a large document */
+/*	the same keystrokes go through a full render and through an
+ *	sd_document; both outputs are compared after every one of them */
+
+#include "markdown.h"
+#include "html.h"
+#include "buffer.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define EXTENSIONS (MKDEXT_TABLES | MKDEXT_FENCED_CODE | MKDEXT_AUTOLINK | \
+	MKDEXT_STRIKETHROUGH | MKDEXT_SUPERSCRIPT)
+
+int
+main(int argc, char **argv)
+{
+	static const char typed[] = "Some *more* text, typed in [here](http://example.com)\n";
+
+	struct sd_callbacks callbacks;
+	struct html_renderopt options;
+	struct sd_config *cfg;
+	struct sd_markdown *md;
+	struct sd_document *doc;
+	struct buf *text, *ob;
+	size_t kbytes = 200, keys = 500, pos, n, k;
+	double full = 0.0, incremental = 0.0, t;
+	int same = 1;
+
+	if (argc > 1)
+		kbytes = strtoul(argv[1], NULL, 10);
+	if (argc > 2)
+		keys = strtoul(argv[2], NULL, 10);
+
+	sdhtml_renderer(&callbacks, &options, 0);
+	cfg = sd_config_new(EXTENSIONS, 16, &callbacks);
+	md = sd_markdown_new_context(cfg, &options);
+	doc = sd_document_new(cfg, &options);
+
+	text = bufnew(64 * 1024);
+	ob = bufnew(64 * 1024);
+
+	for (n = 0; text->size < kbytes * 1024; ++n)
+		put_section(text, (unsigned int)n);
+
+	sd_document_update(doc, text->data, text->size);
+
+	/* typing at the start of the paragraph in the middle section */
+	bufputc(text, 0);
+	pos = strstr((char *)text->data + text->size / 2, "The *option*") - (char *)text->data;
+	text->size--;
+
+	for (k = 0; k < keys; ++k) {
+		const uint8_t *c = (const uint8_t *)&typed[k % (sizeof(typed) - 1)];
+		const struct buf *html;
+
+		bufput(text, c, 1);
+		memmove(text->data + pos + k + 1, text->data + pos + k, text->size - pos - k - 1);
+		text->data[pos + k] = *c;
+
+		t = now();
+		ob->size = 0;
+		sd_markdown_render(ob, text->data, text->size, md);
+		full += now() - t;
+
+		t = now();
+		sd_document_edit(doc, pos + k, 0, c, 1);
+		incremental += now() - t;
+
+		html = sd_document_output(doc);
+		if (html->size != ob->size || memcmp(html->data, ob->data, ob->size) != 0)
+			same = 0;
+	}
+
+	printf("%zu bytes, %zu keystrokes\n", text->size, keys);
+	printf("%-12s %10s\n", "render", "us/key");
+	printf("%-12s %10.1f\n", "full", full / keys * 1e6);
+	printf("%-12s %10.1f%s\n", "incremental", incremental / keys * 1e6,
+		same ? "" : "  output differs");
+
+	sd_document_free(doc);
+	sd_markdown_free(md);
+	sd_config_free(cfg);
+	bufrelease(text);
+	bufrelease(ob);
+	return 0;
+}
+
+/* vim: set filetype=c: */
@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2026, agent
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* inline • parse_inline throughput on plain prose, with a bare renderer */
+/*	build with -DSUNDOWN_NO_SIMD to compare against the byte loop */
+
+#include "markdown.h"
+#include "buffer.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DOC_SIZE (4 * 1024 * 1024)
+
+static void
+bench_paragraph(struct buf *ob, const struct buf *text, void *opaque)
+{
+	bufput(ob, text->data, text->size);
+}
+
+int
+main(int argc, char **argv)
+{
+	static const char *words[] = {
+		"lorem", "ipsum", "dolor", "sit", "amet,", "consectetur",
+		"adipiscing", "elit.", "sed", "do", "eiusmod", "tempor",
+		"incididunt", "ut", "labore", "et", "dolore", "magna", "aliqua.",
+	};
+	static const char *names[] = { "none", "autolink" };
+	static const unsigned int exts[] = { 0, MKDEXT_AUTOLINK };
+
+	struct sd_callbacks callbacks;
+	struct buf *doc, *ob;
+	size_t n, round, rounds = 10;
+	unsigned int seed = 1;
+	int e;
+
+	if (argc > 1)
+		rounds = strtoul(argv[1], NULL, 10);
+
+	/* sentences of common words, a paragraph every dozen lines */
+	doc = bufnew(1024);
+	for (n = 0; doc->size < DOC_SIZE; ++n) {
+		seed = seed * 1103515245 + 12345;
+		bufputs(doc, words[(seed >> 16) % (sizeof(words) / sizeof(words[0]))]);
+		bufputc(doc, (n % 12) == 11 ? '\n' : ' ');
+		if (n % 144 == 143)
+			bufputc(doc, '\n');
+	}
+
+	memset(&callbacks, 0x0, sizeof(callbacks));
+	callbacks.paragraph = bench_paragraph;
+
+	printf("%-10s %10s %10s %10s\n", "ext", "bytes", "ms", "MB/s");
+
+	for (e = 0; e < 2; ++e) {
+		struct sd_markdown *md = sd_markdown_new(exts[e], 16, &callbacks, NULL);
+		double start, best = 0.0;
+
+		ob = bufnew(64);
+		for (round = 0; round < rounds; ++round) {
+			ob->size = 0;
+			start = now();
+			sd_markdown_render(ob, doc->data, doc->size, md);
+			start = now() - start;
+
+			if (round == 0 || start < best)
+				best = start;
+		}
+
+		printf("%-10s %10zu %10.3f %10.1f\n",
+			names[e], doc->size, best * 1e3, doc->size / best / (1024 * 1024));
+
+		bufrelease(ob);
+		sd_markdown_free(md);
+	}
+
+	bufrelease(doc);
+	return 0;
+}
+
+/* vim: set filetype=c: */
@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2026, agent
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* parallel • render throughput of a large manual as threads are added */
+/*	every multi-threaded output is compared against the serial one */
+
+#include "markdown.h"
+#include "html.h"
+#include "buffer.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RUNS 3
+
+int
+main(int argc, char **argv)
+{
+	struct sd_callbacks callbacks;
+	struct html_renderopt options;
+	struct sd_markdown *md;
+	struct buf *doc, *serial, *ob;
+	size_t mbytes = 8, n;
+	unsigned int threads, max_threads = 16;
+	double serial_time = 0.0;
+
+	if (argc > 1)
+		mbytes = strtoul(argv[1], NULL, 10);
+	if (argc > 2)
+		max_threads = (unsigned int)strtoul(argv[2], NULL, 10);
+
+	sdhtml_renderer(&callbacks, &options, 0);
+	md = sd_markdown_new(MKDEXT_TABLES | MKDEXT_FENCED_CODE | MKDEXT_AUTOLINK |
+		MKDEXT_STRIKETHROUGH | MKDEXT_SUPERSCRIPT, 16, &callbacks, &options);
+
+	/* past the 16MB ceiling of a single buffer */
+	sd_markdown_set_memory_limit(md, (size_t)1 << 31);
+
+	doc = bufnew(1024 * 1024);
+	serial = bufnew(1024 * 1024);
+	ob = bufnew(1024 * 1024);
+
+	for (n = 0; doc->size < mbytes * 1024 * 1024; ++n)
+		put_section(doc, (unsigned int)n);
+
+	printf("%-8s %10s %10s %10s %8s\n", "threads", "bytes", "ms", "MB/s", "speedup");
+
+	for (threads = 1; threads <= max_threads; threads *= 2) {
+		double best = 0.0;
+		int run, same;
+
+		sd_markdown_set_threads(md, threads);
+
+		for (run = 0; run < RUNS; ++run) {
+			double start;
+
+			ob->size = 0;
+			start = now();
+			sd_markdown_render(ob, doc->data, doc->size, md);
+			start = now() - start;
+
+			if (run == 0 || start < best)
+				best = start;
+		}
+
+		if (threads == 1) {
+			bufput(serial, ob->data, ob->size);
+			serial_time = best;
+		}
+
+		same = (ob->size == serial->size && memcmp(ob->data, serial->data, ob->size) == 0);
+
+		printf("%-8u %10zu %10.1f %10.1f %7.2fx%s\n",
+			threads, doc->size, best * 1e3, doc->size / best / 1e6,
+			serial_time / best, same ? "" : "  output differs");
+	}
+
+	sd_markdown_free(md);
+	bufrelease(doc);
+	bufrelease(serial);
+	bufrelease(ob);
+	return 0;
+}
+
+/* vim: set filetype=c: */
@@ -0,0 +1,214 @@
+/*
+ * Copyright (c) 2026, agent
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* suite • sd_markdown_render over one generated document per corpus class */
+/*	every class runs in a child process of its own, so that its peak RSS
+ *	is not the one of the classes before it. The counters come from a
+ *	warm render with SUNDOWN_STATS, the times from renders without them.
+ *	-m prints tab-separated lines for regression tracking; files given
+ *	after the options are run as classes of their own */
+
+#include "markdown.h"
+#include "html.h"
+#include "buffer.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#define EXTENSIONS (MKDEXT_TABLES | MKDEXT_FENCED_CODE | MKDEXT_AUTOLINK | \
+	MKDEXT_STRIKETHROUGH)
+
+/* lists and quotes nested eight levels down */
+static void
+put_nested_8(struct buf *doc, size_t size)
+{
+	put_nested(doc, size, 8);
+}
+
+static const struct {
+	const char *name;
+	void (*put)(struct buf *, size_t);
+	size_t scale;	/* of the document size */
+} classes[] = {
+	{ "prose", put_prose, 1 },
+	{ "links", put_links, 1 },
+	{ "tables", put_tables, 1 },
+	{ "nested", put_nested_8, 1 },
+	{ "html", put_html, 1 },
+	{ "emphasis", put_emphasis, 1 },
+	{ "large", put_manual, 8 },
+};
+
+static int machine;
+
+/* run • one class, in the child process */
+static int
+run(const char *name, struct buf *doc, int rounds)
+{
+	struct sd_callbacks callbacks;
+	struct html_renderopt options;
+	struct sd_render_stats stats;
+	struct sd_markdown *md;
+	struct rusage usage;
+	struct buf *ob;
+	size_t allocs;
+	double start, elapsed;
+	int i, status;
+
+	sdhtml_renderer(&callbacks, &options, 0);
+	md = sd_markdown_new(EXTENSIONS, 16, &callbacks, &options);
+	ob = bufnew(64 * 1024);
+	if (!md || !ob)
+		return 1;
+
+	/* the first render warms up, the second one counts */
+	sd_markdown_render(ob, doc->data, doc->size, md);
+	if (sd_markdown_set_stats(md, &stats) < 0)
+		return 1;
+	ob->size = 0;
+	status = sd_markdown_render(ob, doc->data, doc->size, md);
+	sd_markdown_set_stats(md, NULL);
+
+	/* a failed render would only time how early it gave up */
+	if (status != MKD_OK) {
+		fprintf(stderr, "%s: render failed (%d)\n", name, status);
+		return 1;
+	}
+	allocs = stats.allocs + stats.reallocs;
+
+	start = now();
+	for (i = 0; i < rounds; ++i) {
+		ob->size = 0;
+		sd_markdown_render(ob, doc->data, doc->size, md);
+	}
+	elapsed = (now() - start) / rounds;
+
+	getrusage(RUSAGE_SELF, &usage);
+
+	if (machine)
+		printf("%s\t%zu\t%.2f\t%.3f\t%zu\t%ld\n", name, doc->size,
+			doc->size / elapsed / 1e6, elapsed * 1e9 / doc->size,
+			allocs, usage.ru_maxrss);
+	else
+		printf("%-10s %10zu %10.1f %10.2f %10zu %10ld\n", name, doc->size,
+			doc->size / elapsed / 1e6, elapsed * 1e9 / doc->size,
+			allocs, usage.ru_maxrss);
+
+	/* the child leaves through _exit, without flushing stdio */
+	fflush(stdout);
+	sd_markdown_free(md);
+	bufrelease(ob);
+	return 0;
+}
+
+/* spawn • runs one class, generated or read from path, in a child */
+static int
+spawn(size_t index, const char *path, size_t size, int rounds)
+{
+	struct buf *doc;
+	const char *name;
+	pid_t pid;
+	int status;
+
+	fflush(stdout);
+	pid = fork();
+	if (pid < 0)
+		return -1;
+
+	if (pid == 0) {
+		doc = bufnew(64 * 1024);
+
+		if (path) {
+			FILE *in = fopen(path, "rb");
+			size_t ret;
+
+			if (!in) {
+				fprintf(stderr, "unable to open %s\n", path);
+				_exit(1);
+			}
+
+			do {
+				bufgrow(doc, doc->size + 64 * 1024);
+				ret = fread(doc->data + doc->size, 1, doc->asize - doc->size, in);
+				doc->size += ret;
+			} while (ret > 0);
+
+			fclose(in);
+			name = path;
+		} else {
+			/* bufgrow stops at BUFFER_MAX_ALLOC_SIZE, and so would the
+			 * generators, forever */
+			size *= classes[index].scale;
+			if (size > BUFFER_MAX_ALLOC_SIZE - 64 * 1024)
+				size = BUFFER_MAX_ALLOC_SIZE - 64 * 1024;
+
+			classes[index].put(doc, size);
+			name = classes[index].name;
+		}
+
+		_exit(run(name, doc, rounds));
+	}
+
+	if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status))
+		return -1;
+
+	return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+	size_t size = 1024 * 1024, c;
+	int rounds = 10, failed = 0, i = 1;
+
+	if (i < argc && strcmp(argv[i], "-m") == 0) {
+		machine = 1;
+		++i;
+	}
+	if (i < argc && strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+		size = strtoul(argv[i + 1], NULL, 10) * 1024;
+		i += 2;
+	}
+	if (i < argc && strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+		rounds = atoi(argv[i + 1]);
+		i += 2;
+	}
+
+	if (machine)
+		printf("class\tbytes\tmb_per_s\tns_per_byte\tallocs_per_doc\tpeak_rss_kb\n");
+	else
+		printf("%-10s %10s %10s %10s %10s %10s\n", "class", "bytes", "MB/s",
+			"ns/byte", "allocs", "RSS kB");
+
+	for (c = 0; c < sizeof(classes) / sizeof(classes[0]); ++c)
+		if (spawn(c, NULL, size, rounds) < 0) {
+			failed = 1;
+		}
+
+	for (; i < argc; ++i)
+		if (spawn(0, argv[i], size, rounds) < 0) {
+			failed = 1;
+		}
+
+	return failed;
+}
+
+/* vim: set filetype=c: */
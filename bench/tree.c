@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2026, agent
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* tree • a document rendered to HTML and to a TOC, parsed for each or once */
+/*	the tree is parsed with the nodes the TOC renderer has no callback
+ *	for skipped, so both renders match the ones from the text; the
+ *	outputs of the two ways are compared */
+
+#include "markdown.h"
+#include "html.h"
+#include "buffer.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define EXTENSIONS (MKDEXT_TABLES | MKDEXT_FENCED_CODE | MKDEXT_STRIKETHROUGH)
+
+/* what the TOC renderer leaves out, and so does the HTML one here */
+#define SKIP ((1 << MKDN_BLOCKHTML) | (1 << MKDN_AUTOLINK) | (1 << MKDN_IMAGE) | \
+	(1 << MKDN_LINEBREAK) | (1 << MKDN_RAW_HTML))
+
+int
+main(int argc, char **argv)
+{
+	struct sd_callbacks html_cb, toc_cb;
+	struct html_renderopt html_opt, toc_opt;
+	struct sd_events events;
+	struct sd_config *tree_cfg;
+	struct sd_markdown *html_md, *toc_md, *tree_md;
+	struct buf *doc, *tree, *html, *toc, *check;
+	size_t size = 4 * 1024 * 1024;
+	double parse_both = 0, build = 0, render_both = 0, t;
+	int rounds = 10, i, same;
+
+	if (argc > 1)
+		size = strtoul(argv[1], NULL, 10) * 1024;
+	if (argc > 2)
+		rounds = atoi(argv[2]);
+
+	sdhtml_renderer(&html_cb, &html_opt, 0);
+	html_cb.blockhtml = NULL;
+	html_cb.autolink = NULL;
+	html_cb.image = NULL;
+	html_cb.linebreak = NULL;
+	html_cb.raw_html_tag = NULL;
+
+	sdhtml_toc_renderer(&toc_cb, &toc_opt);
+	html_md = sd_markdown_new(EXTENSIONS, 16, &html_cb, &html_opt);
+	toc_md = sd_markdown_new(EXTENSIONS, 16, &toc_cb, &toc_opt);
+
+	sd_tree_events(&events, SKIP);
+	tree_cfg = sd_config_new_events(EXTENSIONS, 16, &events);
+	tree_md = sd_markdown_new_context(tree_cfg, NULL);
+
+	doc = bufnew(64 * 1024);
+	tree = bufnew(64 * 1024);
+	html = bufnew(64 * 1024);
+	toc = bufnew(64 * 1024);
+	check = bufnew(64 * 1024);
+	put_manual(doc, size);
+
+	for (i = 0; i < rounds; ++i) {
+		t = now();
+		html->size = toc->size = 0;
+		sd_markdown_render(html, doc->data, doc->size, html_md);
+		sdhtml_toc_renderer(&toc_cb, &toc_opt);
+		sd_markdown_render(toc, doc->data, doc->size, toc_md);
+		parse_both += now() - t;
+
+		t = now();
+		tree->size = 0;
+		sd_markdown_render(tree, doc->data, doc->size, tree_md);
+		build += now() - t;
+
+		t = now();
+		check->size = 0;
+		sd_tree_render(check, tree->data, tree->size, &html_cb, &html_opt);
+		sdhtml_toc_renderer(&toc_cb, &toc_opt);
+		sd_tree_render(check, tree->data, tree->size, &toc_cb, &toc_opt);
+		render_both += now() - t;
+	}
+
+	same = check->size == html->size + toc->size &&
+		memcmp(check->data, html->data, html->size) == 0 &&
+		memcmp(check->data + html->size, toc->data, toc->size) == 0;
+
+	printf("%zu bytes, tree of %zu bytes (%.2fx)\n", doc->size, tree->size,
+		(double)tree->size / doc->size);
+	printf("%-20s %10.1fMB/s\n", "parse html + toc", doc->size * rounds / parse_both / 1e6);
+	printf("%-20s %10.1fMB/s\n", "build tree", doc->size * rounds / build / 1e6);
+	printf("%-20s %10.1fMB/s%s\n", "tree to html + toc", doc->size * rounds / render_both / 1e6,
+		same ? "" : "  output differs");
+
+	sd_markdown_free(html_md);
+	sd_markdown_free(toc_md);
+	sd_markdown_free(tree_md);
+	sd_config_free(tree_cfg);
+	bufrelease(doc);
+	bufrelease(tree);
+	bufrelease(html);
+	bufrelease(toc);
+	bufrelease(check);
+	return 0;
+}
+
+/* vim: set filetype=c: */
@@ -17,64 +17,866 @@
 #include "markdown.h"
 #include "html.h"
 #include "buffer.h"
+#include "pool.h"
 
 #include <errno.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#  include <windows.h>
+#  include <io.h>
+#  include <direct.h>
+#  define read _read
+#  define write _write
+#  define mkdir(path, mode) _mkdir(path)
+#  define S_ISREG(mode) (((mode) & _S_IFMT) == _S_IFREG)
+typedef SSIZE_T ssize_t;
+#else
+#  include <unistd.h>
+#  include <sys/mman.h>
+#endif
 
 #define READ_UNIT 1024
-#define OUTPUT_UNIT 64
 
-/* main • main function, interfacing STDIO with the parser */
+/* heap hooks: buffers with hooks of their own are not held to the 16MB
+ * ceiling of libc-backed ones: a whole document, or its output, fits */
+static void *
+heap_realloc(void *opaque, void *ptr, size_t old_size, size_t new_size)
+{
+	return realloc(ptr, new_size);
+}
+
+static void
+heap_free(void *opaque, void *ptr, size_t size)
+{
+	free(ptr);
+}
+
+static const struct buf_allocator heap = { heap_realloc, heap_free, NULL };
+
+/* NO_BUDGET: memory limit lifting the per-buffer ceiling of a render */
+#define NO_BUDGET ((size_t)-1)
+
+/* input: the document, mapped or read into a buffer */
+struct input {
+	const uint8_t *data;
+	size_t size;
+	size_t mapped;	/* length of the mapping, 0 when read */
+	struct buf *ib;
+};
+
+/* read_input • reads fd to its end, in steps sized after what fstat knows */
+static int
+read_input(struct input *in, int fd, const struct stat *st)
+{
+	size_t unit = READ_UNIT;
+	ssize_t ret;
+
+	/* a regular file is read whole, a pipe a pipe buffer at a time */
+	if (S_ISREG(st->st_mode) && st->st_size > 0)
+		unit = (size_t)st->st_size + 1;
+#ifndef _WIN32
+	else if (st->st_blksize > READ_UNIT)
+		unit = (size_t)st->st_blksize;
+#endif
+
+	in->ib = bufnew_with(unit, &heap);
+	if (!in->ib || bufgrow(in->ib, unit) < 0) {
+		errno = ENOMEM;
+		return -1;
+	}
+
+	for (;;) {
+		if (in->ib->size == in->ib->asize &&
+			bufgrow(in->ib, in->ib->size + unit) < 0) {
+			errno = ENOMEM;
+			return -1;
+		}
+
+		ret = read(fd, in->ib->data + in->ib->size, in->ib->asize - in->ib->size);
+		if (ret == 0)
+			break;
+
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+
+		in->ib->size += ret;
+	}
+
+	in->data = in->ib->data;
+	in->size = in->ib->size;
+	return 0;
+}
+
+/* open_input • maps a regular file, reads anything else */
+static int
+open_input(struct input *in, int fd)
+{
+	struct stat st;
+
+	memset(in, 0x0, sizeof(struct input));
+
+	if (fstat(fd, &st) < 0)
+		return -1;
+
+#ifndef _WIN32
+	/* the parser reads the pages of the file where they lie */
+	if (S_ISREG(st.st_mode) && st.st_size > 0) {
+		void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+		if (map != MAP_FAILED) {
+			madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+			in->data = map;
+			in->size = in->mapped = (size_t)st.st_size;
+			return 0;
+		}
+	}
+#endif
+
+	return read_input(in, fd, &st);
+}
+
+static void
+close_input(struct input *in)
+{
+#ifndef _WIN32
+	if (in->mapped)
+		munmap((void *)in->data, in->mapped);
+#endif
+	bufrelease(in->ib);
+}
+
+/* write_output • sink writing every chunk straight to the fd in opaque */
+static int
+write_output(const uint8_t *data, size_t size, void *opaque)
+{
+	int fd = *(int *)opaque;
+	ssize_t ret;
+
+	while (size > 0) {
+		ret = write(fd, data, size);
+
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+
+		data += ret;
+		size -= ret;
+	}
+
+	return 0;
+}
+
+/* now • monotonic seconds */
+static double
+now(void)
+{
+#ifdef _WIN32
+	LARGE_INTEGER count, freq;
+	QueryPerformanceCounter(&count);
+	QueryPerformanceFrequency(&freq);
+	return (double)count.QuadPart / freq.QuadPart;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+#endif
+}
+
+/* settings: the parser and renderer asked for on the command line */
+struct settings {
+	unsigned int extensions;
+	unsigned int render_flags;
+	size_t max_nesting;
+	int toc;	/* renders the table of contents alone */
+	int smartypants;	/* post-processes the HTML */
+	unsigned int repeat;	/* renders of the document, only the last written */
+	int stats;	/* times the renders apart from the I/O */
+};
+
+struct flag_name {
+	const char *name;
+	unsigned int flag;
+};
+
+/* one --option for every bit of mkd_extensions */
+static const struct flag_name extension_names[] = {
+	{ "no-intra-emphasis", MKDEXT_NO_INTRA_EMPHASIS },
+	{ "tables", MKDEXT_TABLES },
+	{ "fenced-code", MKDEXT_FENCED_CODE },
+	{ "autolink", MKDEXT_AUTOLINK },
+	{ "strikethrough", MKDEXT_STRIKETHROUGH },
+	{ "space-headers", MKDEXT_SPACE_HEADERS },
+	{ "superscript", MKDEXT_SUPERSCRIPT },
+	{ "lax-spacing", MKDEXT_LAX_SPACING },
+};
+
+/* and for every bit of html_render_mode */
+static const struct flag_name render_names[] = {
+	{ "skip-html", HTML_SKIP_HTML },
+	{ "skip-style", HTML_SKIP_STYLE },
+	{ "skip-images", HTML_SKIP_IMAGES },
+	{ "skip-links", HTML_SKIP_LINKS },
+	{ "expand-tabs", HTML_EXPAND_TABS },
+	{ "safelink", HTML_SAFELINK },
+	{ "toc-ids", HTML_TOC },
+	{ "hard-wrap", HTML_HARD_WRAP },
+	{ "xhtml", HTML_USE_XHTML },
+	{ "escape", HTML_ESCAPE },
+};
+
+#define FLAG_COUNT(names) (sizeof(names) / sizeof(names[0]))
+
+/* find_flag • the bit of an option name, 0 when unknown */
+static unsigned int
+find_flag(const struct flag_name *names, size_t count, const char *name)
+{
+	size_t i;
+
+	for (i = 0; i < count; ++i)
+		if (strcmp(names[i].name, name) == 0)
+			return names[i].flag;
+
+	return 0;
+}
+
+/* renderer_init • the HTML or TOC renderer the settings ask for */
+static void
+renderer_init(struct sd_callbacks *callbacks, struct html_renderopt *options,
+	const struct settings *set)
+{
+	if (set->toc)
+		sdhtml_toc_renderer(callbacks, options);
+	else
+		sdhtml_renderer(callbacks, options, set->render_flags);
+}
+
+/* render_to • renders a document to fd, streamed unless smartypants
+ * needs the whole HTML; ob and sb are its working buffers */
+static int
+render_to(int fd, const struct input *in, struct sd_markdown *md,
+	struct html_renderopt *options, const struct settings *set,
+	struct buf *ob, struct buf *sb)
+{
+	int status;
+
+	/* header numbers start over with every document */
+	memset(&options->toc_data, 0x0, sizeof(options->toc_data));
+
+	if (!set->smartypants)
+		return sd_markdown_render_stream(in->data, in->size, md, write_output, &fd);
+
+	ob->size = sb->size = 0;
+	status = sd_markdown_render(ob, in->data, in->size, md);
+	sdhtml_smartypants(sb, ob->data, ob->size);
+
+	if (write_output(sb->data, sb->size, &fd) < 0)
+		return MKD_ESINK;
+
+	return status;
+}
+
+/* print_counters • what a build with SUNDOWN_STATS counted in a render */
+static void
+print_counters(const struct sd_render_stats *st)
+{
+	static const char *triggers[MKDS_TRIGGERS] = {
+		"emphasis", "codespan", "linebreak", "link", "langle", "escape",
+		"entity", "autolink-url", "autolink-email", "autolink-www", "superscript",
+	};
+	static const char *blocks[MKDS_BLOCKS] = {
+		"paragraph", "atxheader", "htmlblock", "hrule", "fencedcode",
+		"table", "blockquote", "blockcode", "list", "listitem",
+	};
+	int i;
+
+	fprintf(stderr, "%-16s %10s %10s %12s\n", "parser", "calls", "misses", "bytes");
+
+	for (i = 0; i < MKDS_BLOCKS; ++i)
+		if (st->block_calls[i])
+			fprintf(stderr, "%-16s %10zu %10zu %12zu\n", blocks[i],
+				st->block_calls[i], st->block_misses[i], st->block_bytes[i]);
+
+	for (i = 0; i < MKDS_TRIGGERS; ++i)
+		if (st->trigger_calls[i])
+			fprintf(stderr, "%-16s %10zu %10zu %12zu\n", triggers[i],
+				st->trigger_calls[i], st->trigger_misses[i], st->trigger_bytes[i]);
+
+	fprintf(stderr, "buffers: %zu new, %zu reused, %zu deep; "
+		"%zu allocations, %zu reallocations\n",
+		st->bufs_new, st->bufs_reused, st->max_depth, st->allocs, st->reallocs);
+}
+
+/* render_timed • --repeat and --stats: renders in memory, then writes once */
+static int
+render_timed(int fd, const struct input *in, double read_time, struct sd_markdown *md,
+	struct html_renderopt *options, const struct settings *set)
+{
+	struct sd_render_stats counters;
+	struct buf *ob, *sb, *out;
+	double start, elapsed, best = 0, total = 0, smarty = 0, write_time;
+	int counted, status = MKD_OK;
+	unsigned int r;
+
+	ob = bufnew_with(64 * 1024, &heap);
+	sb = bufnew_with(64 * 1024, &heap);
+	if (!ob || !sb) {
+		bufrelease(ob);
+		bufrelease(sb);
+		return MKD_ENOMEM;
+	}
+
+	counted = set->stats && sd_markdown_set_stats(md, &counters) == 0;
+
+	for (r = 0; r < set->repeat; ++r) {
+		memset(&options->toc_data, 0x0, sizeof(options->toc_data));
+		ob->size = 0;
+
+		start = now();
+		status = sd_markdown_render(ob, in->data, in->size, md);
+		elapsed = now() - start;
+
+		total += elapsed;
+		if (r == 0 || elapsed < best)
+			best = elapsed;
+
+		if (set->smartypants) {
+			sb->size = 0;
+			start = now();
+			sdhtml_smartypants(sb, ob->data, ob->size);
+			smarty += now() - start;
+		}
+	}
+
+	if (counted)
+		sd_markdown_set_stats(md, NULL);
+
+	out = set->smartypants ? sb : ob;
+	start = now();
+	if (write_output(out->data, out->size, &fd) < 0)
+		status = MKD_ESINK;
+	write_time = now() - start;
+
+	if (set->stats) {
+		fprintf(stderr, "read        %10zu bytes %10.3fms (%s)\n", in->size,
+			read_time * 1e3, in->mapped ? "mapped" : "read");
+		fprintf(stderr, "render      %10u times %10.3fms mean, %.3fms best: %.1fMB/s, %.2fns/byte\n",
+			set->repeat, total / set->repeat * 1e3, best * 1e3,
+			best > 0 ? in->size / best / 1e6 : 0.0, best * 1e9 / (in->size ? in->size : 1));
+		if (set->smartypants)
+			fprintf(stderr, "smartypants %10u times %10.3fms mean\n",
+				set->repeat, smarty / set->repeat * 1e3);
+		fprintf(stderr, "write       %10zu bytes %10.3fms\n", out->size, write_time * 1e3);
+
+		if (counted)
+			print_counters(&counters);
+	}
+
+	bufrelease(ob);
+	bufrelease(sb);
+	return status;
+}
+
+/* worker: what one thread of a batch keeps from a file to the next */
+struct worker {
+	struct sd_markdown *md;
+	struct html_renderopt options;
+	struct buf *ob, *sb;	/* for smartypants */
+	struct buf *path;	/* of the output */
+	size_t files, bytes;
+	int failed;
+};
+
+/* batch: files rendered to mirrored paths by the worker pool */
+struct batch {
+	const struct sd_config *cfg;
+	const struct settings *set;
+	struct worker *workers;	/* one per thread */
+	char **paths;
+	const char *outdir;	/* NULL: next to the inputs */
+};
+
+/* output_path • the input path under outdir, with its extension made .html */
+/*	relative paths are kept as they are, absolute ones moved under outdir;
+ *	paths going up with .. are refused */
+static int
+output_path(struct buf *out, const char *outdir, const char *path)
+{
+	const char *base, *ext, *p;
+
+	out->size = 0;
+
+	if (outdir) {
+		while (*path == '/' || (path[0] == '.' && path[1] == '/'))
+			path += (*path == '/') ? 1 : 2;
+
+		for (p = path; *p; p = strchr(p, '/') ? strchr(p, '/') + 1 : p + strlen(p))
+			if (p[0] == '.' && p[1] == '.' && (p[2] == '/' || p[2] == 0))
+				return -1;
+
+		bufputs(out, outdir);
+		if (out->size && out->data[out->size - 1] != '/')
+			bufputc(out, '/');
+	}
+
+	base = strrchr(path, '/');
+	base = base ? base + 1 : path;
+	ext = strrchr(base, '.');
+	if (!ext || ext == base)
+		ext = base + strlen(base);
+
+	bufput(out, path, ext - path);
+	bufputs(out, ".html");
+	return bufcstr(out) ? 0 : -1;
+}
+
+/* make_parents • creates the directories of path, from byte from onwards */
+static int
+make_parents(struct buf *path, size_t from)
+{
+	size_t i;
+
+	for (i = from; i < path->size; ++i) {
+		if (path->data[i] != '/' || i == 0)
+			continue;
+
+		path->data[i] = 0;
+		if (mkdir((char *)path->data, 0755) < 0 && errno != EEXIST) {
+			path->data[i] = '/';
+			return -1;
+		}
+		path->data[i] = '/';
+	}
+
+	return 0;
+}
+
+/* render_file • pool task rendering one file of a batch */
+static void
+render_file(void *opaque, size_t index, unsigned int worker)
+{
+	struct batch *batch = opaque;
+	struct worker *w = &batch->workers[worker];
+	const char *path = batch->paths[index];
+	struct input in;
+	int fd, out, status;
+
+	/* each thread renders with its own context and renderer state */
+	if (!w->md) {
+		struct sd_callbacks callbacks;
+
+		renderer_init(&callbacks, &w->options, batch->set);
+		w->md = sd_markdown_new_context(batch->cfg, &w->options);
+		w->ob = bufnew_with(64 * 1024, &heap);
+		w->sb = bufnew_with(64 * 1024, &heap);
+		w->path = bufnew(256);
+
+		if (!w->md || !w->ob || !w->sb || !w->path) {
+			fprintf(stderr, "%s: out of memory\n", path);
+			w->failed = 1;
+			return;
+		}
+
+		sd_markdown_set_memory_limit(w->md, NO_BUDGET);
+	}
+
+	if (output_path(w->path, batch->outdir, path) < 0 ||
+		(!batch->outdir && strcmp((char *)w->path->data, path) == 0)) {
+		fprintf(stderr, "%s: no output path to mirror it to\n", path);
+		w->failed = 1;
+		return;
+	}
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0 || open_input(&in, fd) < 0) {
+		fprintf(stderr, "%s: %s\n", path, strerror(errno));
+		if (fd >= 0)
+			close(fd);
+		w->failed = 1;
+		return;
+	}
+	close(fd);
+
+	if (batch->outdir)
+		make_parents(w->path, strlen(batch->outdir));
+
+	out = open((char *)w->path->data, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	status = out < 0 ? MKD_ESINK :
+		render_to(out, &in, w->md, &w->options, batch->set, w->ob, w->sb);
+
+	if (status == MKD_ESINK) {
+		fprintf(stderr, "%s: %s\n", (char *)w->path->data, strerror(errno));
+		w->failed = 1;
+	} else {
+		if (status != MKD_OK)
+			fprintf(stderr, "%s: output truncated, out of memory\n", path);
+		w->files++;
+		w->bytes += in.size;
+	}
+
+	if (out >= 0)
+		close(out);
+	close_input(&in);
+}
+
+/* read_paths • one path per line of fd, in place in list */
+static char **
+read_paths(struct input *list, int fd, size_t *count)
+{
+	struct stat st;
+	char **paths;
+	size_t i, n = 0;
+	char *line;
+
+	memset(list, 0x0, sizeof(struct input));
+	if (fstat(fd, &st) < 0 || read_input(list, fd, &st) < 0 || !bufcstr(list->ib))
+		return NULL;
+
+	for (i = 0; i < list->ib->size; ++i)
+		if (list->ib->data[i] == '\n')
+			n++;
+
+	paths = malloc((n + 1) * sizeof(char *));
+	if (!paths)
+		return NULL;
+
+	*count = 0;
+	for (line = (char *)list->ib->data; *line; ) {
+		char *eol = strchr(line, '\n');
+
+		if (eol) {
+			*eol = 0;
+			if (eol > line && eol[-1] == '\r')
+				eol[-1] = 0;
+		}
+
+		if (*line)
+			paths[(*count)++] = line;
+
+		if (!eol)
+			break;
+		line = eol + 1;
+	}
+
+	return paths;
+}
+
+/* clean_path • drops the ./ components and the doubled slashes of path */
+static void
+clean_path(char *path)
+{
+	char *r = path, *w = path;
+
+	while (*r) {
+		if (*r == '/' && w > path && w[-1] == '/')
+			r++;
+		else if (r[0] == '.' && r[1] == '/' && (r == path || r[-1] == '/'))
+			r += 2;
+		else
+			*w++ = *r++;
+	}
+
+	*w = 0;
+}
+
+static int
+cmp_outputs(const void *a, const void *b)
+{
+	return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+/* check_outputs • refuses batches where two files render to the same path */
+/*	both would truncate and write that file at the same time; every name
+ *	is the output path followed by the input one, sorted by the former */
+static int
+check_outputs(char **paths, size_t count, const char *outdir)
+{
+	struct buf *out = bufnew(256);
+	char **names = calloc(count + 1, sizeof(char *));
+	size_t i, n = 0;
+	int failed = 0;
+
+	if (!out || !names) {
+		fprintf(stderr, "Out of memory\n");
+		failed = 1;
+		goto cleanup;
+	}
+
+	for (i = 0; i < count; ++i) {
+		size_t len = strlen(paths[i]);
+
+		/* render_file tells about those */
+		if (output_path(out, outdir, paths[i]) < 0)
+			continue;
+
+		names[n] = malloc(out->size + len + 2);
+		if (!names[n]) {
+			fprintf(stderr, "Out of memory\n");
+			failed = 1;
+			goto cleanup;
+		}
+
+		memcpy(names[n], out->data, out->size + 1);
+		clean_path(names[n]);
+		memcpy(names[n] + strlen(names[n]) + 1, paths[i], len + 1);
+		n++;
+	}
+
+	qsort(names, n, sizeof(char *), cmp_outputs);
+
+	for (i = 1; i < n; ++i)
+		if (strcmp(names[i - 1], names[i]) == 0) {
+			fprintf(stderr, "%s, %s: both render to %s\n",
+				names[i - 1] + strlen(names[i - 1]) + 1,
+				names[i] + strlen(names[i]) + 1, names[i]);
+			failed = 1;
+		}
+
+cleanup:
+	for (i = 0; names && i < n; ++i)
+		free(names[i]);
+	free(names);
+	bufrelease(out);
+	return failed;
+}
+
+/* render_batch • renders the files with nthreads threads, and tells how fast */
+static int
+render_batch(char **paths, size_t count, const char *outdir, unsigned int nthreads,
+	const struct settings *set)
+{
+	struct sd_callbacks callbacks;
+	struct html_renderopt options;
+	struct sd_config *cfg;
+	struct batch batch;
+	size_t files = 0, bytes = 0;
+	double start, elapsed;
+	unsigned int i;
+	int failed = 0;
+
+	if (check_outputs(paths, count, outdir))
+		return 1;
+
+	renderer_init(&callbacks, &options, set);
+	cfg = sd_config_new(set->extensions, set->max_nesting, &callbacks);
+	batch.workers = calloc(nthreads, sizeof(struct worker));
+	if (!cfg || !batch.workers) {
+		fprintf(stderr, "Out of memory\n");
+		sd_config_free(cfg);
+		return 1;
+	}
+
+	batch.cfg = cfg;
+	batch.set = set;
+	batch.paths = paths;
+	batch.outdir = outdir;
+
+	start = now();
+	pool_run(nthreads, count, render_file, &batch);
+	elapsed = now() - start;
+
+	for (i = 0; i < nthreads; ++i) {
+		struct worker *w = &batch.workers[i];
+
+		files += w->files;
+		bytes += w->bytes;
+		failed |= w->failed;
+
+		if (w->md)
+			sd_markdown_free(w->md);
+		bufrelease(w->ob);
+		bufrelease(w->sb);
+		bufrelease(w->path);
+	}
+
+	fprintf(stderr, "%zu files, %.1fMB in %.3fs: %.1fMB/s on %u threads\n",
+		files, bytes / 1e6, elapsed, elapsed > 0 ? bytes / elapsed / 1e6 : 0.0, nthreads);
+
+	free(batch.workers);
+	sd_config_free(cfg);
+	return failed;
+}
+
+static void
+usage(void)
+{
+	size_t i;
+
+	fprintf(stderr,
+		"usage: sundown [options] [file]\n"
+		"       sundown [options] [-j threads] [-o dir] [-l] file...\n\n"
+		"  -j N           render the files on N threads\n"
+		"  -o DIR         write file.md to DIR/file.html, instead of next to it\n"
+		"  -l             read the files to render from stdin, one per line\n"
+		"  --nesting N    nest blocks and spans N levels deep at most (16)\n"
+		"  --toc          render the table of contents instead of the document\n"
+		"  --smartypants  turn quotes, dashes and ellipses into entities\n"
+		"  --repeat N     render a single document N times, then write it once\n"
+		"  --stats        time the reads, renders and writes apart\n\n"
+		"extensions:");
+
+	for (i = 0; i < FLAG_COUNT(extension_names); ++i)
+		fprintf(stderr, " --%s", extension_names[i].name);
+
+	fprintf(stderr, "\nrender flags:");
+	for (i = 0; i < FLAG_COUNT(render_names); ++i)
+		fprintf(stderr, " --%s", render_names[i].name);
+
+	fprintf(stderr, "\n");
+}
+
+/* main • main function, interfacing the file descriptors with the parser */
 int
 main(int argc, char **argv)
 {
-	struct buf *ib, *ob;
-	int ret;
-	FILE *in = stdin;
+	struct settings set = { 0, 0, 16, 0, 0, 1, 0 };
+	struct input in;
+	int fd = 0, out = 1, ret, i, list = 0;
+	unsigned int nthreads = 1, flag;
+	const char *outdir = NULL;
+	double read_time;
 
 	struct sd_callbacks callbacks;
 	struct html_renderopt options;
 	struct sd_markdown *markdown;
 
+	for (i = 1; i < argc && argv[i][0] == '-' && argv[i][1]; ++i) {
+		const char *name = argv[i] + 2;
+
+		if (strcmp(argv[i], "--") == 0) {
+			++i;
+			break;
+		}
+		else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+			nthreads = (unsigned int)strtoul(argv[++i], NULL, 10);
+		else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+			outdir = argv[++i];
+		else if (strcmp(argv[i], "-l") == 0)
+			list = 1;
+		else if (argv[i][1] != '-') {
+			usage();
+			return 1;
+		}
+		else if (strcmp(name, "nesting") == 0 && i + 1 < argc)
+			set.max_nesting = strtoul(argv[++i], NULL, 10);
+		else if (strcmp(name, "repeat") == 0 && i + 1 < argc)
+			set.repeat = (unsigned int)strtoul(argv[++i], NULL, 10);
+		else if (strcmp(name, "toc") == 0)
+			set.toc = 1;
+		else if (strcmp(name, "smartypants") == 0)
+			set.smartypants = 1;
+		else if (strcmp(name, "stats") == 0)
+			set.stats = 1;
+		else if ((flag = find_flag(extension_names, FLAG_COUNT(extension_names), name)) != 0)
+			set.extensions |= flag;
+		else if ((flag = find_flag(render_names, FLAG_COUNT(render_names), name)) != 0)
+			set.render_flags |= flag;
+		else {
+			usage();
+			return 1;
+		}
+	}
+
+	if (nthreads == 0)
+		nthreads = 1;
+	if (set.repeat == 0)
+		set.repeat = 1;
+	if (set.max_nesting == 0) {
+		fprintf(stderr, "The nesting has to be at least 1\n");
+		return 1;
+	}
+
+	/* several files, or a directory to put them in: batch mode */
+	if (list || outdir || argc - i > 1) {
+		struct input names;
+		char **paths = argv + i;
+		size_t count = argc - i;
+
+		if (set.repeat > 1 || set.stats) {
+			fprintf(stderr, "--repeat and --stats time a single document\n");
+			return 1;
+		}
+
+		if (list) {
+			paths = read_paths(&names, 0, &count);
+			if (!paths) {
+				fprintf(stderr, "Unable to read the file list: %s\n", strerror(errno));
+				return 1;
+			}
+		}
+
+		ret = render_batch(paths, count, outdir, nthreads, &set);
+
+		if (list) {
+			free(paths);
+			close_input(&names);
+		}
+
+		return ret;
+	}
+
 	/* opening the file if given from the command line */
-	if (argc > 1) {
-		in = fopen(argv[1], "r");
-		if (!in) {
-			fprintf(stderr,"Unable to open input file \"%s\": %s\n", argv[1], strerror(errno));
+	if (i < argc) {
+		fd = open(argv[i], O_RDONLY);
+		if (fd < 0) {
+			fprintf(stderr,"Unable to open input file \"%s\": %s\n", argv[i], strerror(errno));
 			return 1;
 		}
 	}
 
-	/* reading everything */
-	ib = bufnew(READ_UNIT);
-	bufgrow(ib, READ_UNIT);
-	while ((ret = fread(ib->data + ib->size, 1, ib->asize - ib->size, in)) > 0) {
-		ib->size += ret;
-		bufgrow(ib, ib->size + READ_UNIT);
+	/* mapping or reading everything */
+	read_time = now();
+	if (open_input(&in, fd) < 0) {
+		fprintf(stderr, "Unable to read input: %s\n", strerror(errno));
+		return 1;
 	}
+	read_time = now() - read_time;
 
-	if (in != stdin)
-		fclose(in);
+	if (fd != 0)
+		close(fd);
 
-	/* performing markdown parsing */
-	ob = bufnew(OUTPUT_UNIT);
+	/* performing markdown parsing, the output going out as it is rendered */
+	renderer_init(&callbacks, &options, &set);
+	markdown = sd_markdown_new(set.extensions, set.max_nesting, &callbacks, &options);
+	if (!markdown) {
+		fprintf(stderr, "Out of memory\n");
+		close_input(&in);
+		return 1;
+	}
 
-	sdhtml_renderer(&callbacks, &options, 0);
-	markdown = sd_markdown_new(0, 16, &callbacks, &options);
+	sd_markdown_set_memory_limit(markdown, NO_BUDGET);
 
-	sd_markdown_render(ob, ib->data, ib->size, markdown);
-	sd_markdown_free(markdown);
+	if (set.repeat > 1 || set.stats)
+		ret = render_timed(out, &in, read_time, markdown, &options, &set);
+	else {
+		struct buf *ob = bufnew_with(64 * 1024, &heap);
+		struct buf *sb = bufnew_with(64 * 1024, &heap);
+
+		ret = (ob && sb) ? render_to(out, &in, markdown, &options, &set, ob, sb) : MKD_ENOMEM;
+		bufrelease(ob);
+		bufrelease(sb);
+	}
 
-	/* writing the result to stdout */
-	ret = fwrite(ob->data, 1, ob->size, stdout);
+	if (ret == MKD_ESINK)
+		fprintf(stderr, "Unable to write output: %s\n", strerror(errno));
+	else if (ret != MKD_OK)
+		fprintf(stderr, "Warning: output truncated, out of memory\n");
+	sd_markdown_free(markdown);
 
 	/* cleanup */
-	bufrelease(ib);
-	bufrelease(ob);
+	close_input(&in);
 
-	return (ret < 0) ? -1 : 0;
+	return (ret == MKD_ESINK) ? 1 : 0;
 }
 
 /* vim: set filetype=c: */
@@ -4,6 +4,7 @@
 #include <string.h>
 
 #include "houdini.h"
+#include "simd.h"
 
 #define ESCAPE_GROW_FACTOR(x) (((x) * 12) / 10)
 
@@ -51,20 +52,60 @@ static const char HREF_SAFE[] = {
 	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
 };
 
+/* find_unsafe • returns the offset of the next char not in HREF_SAFE */
+static inline size_t
+find_unsafe(const uint8_t *src, size_t i, size_t size)
+{
+#if defined(SD_SIMD_SSE2)
+	/* runs of unsafe chars: not worth setting up the vectors */
+	if (i < size && HREF_SAFE[src[i]] == 0)
+		return i;
+
+	/* signed compares: bytes over 0x7F count as below '!' */
+	while (i + 16 <= size) {
+		__m128i block = _mm_loadu_si128((const __m128i *)(src + i));
+		__m128i hits = _mm_or_si128(
+			_mm_cmplt_epi8(block, _mm_set1_epi8('!')),
+			_mm_cmpgt_epi8(block, _mm_set1_epi8('z')));
+		unsigned int mask;
+
+		/* [ \ ] ^ */
+		hits = _mm_or_si128(hits, _mm_and_si128(
+			_mm_cmpgt_epi8(block, _mm_set1_epi8('Z')),
+			_mm_cmplt_epi8(block, _mm_set1_epi8('_'))));
+
+		hits = _mm_or_si128(hits, _mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8('"')), _mm_cmpeq_epi8(block, _mm_set1_epi8('&'))),
+			_mm_or_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8('\'')), _mm_cmpeq_epi8(block, _mm_set1_epi8('`')))));
+
+		hits = _mm_or_si128(hits, _mm_or_si128(
+			_mm_cmpeq_epi8(block, _mm_set1_epi8('<')), _mm_cmpeq_epi8(block, _mm_set1_epi8('>'))));
+
+		mask = (unsigned int)_mm_movemask_epi8(hits);
+		if (mask)
+			return i + sd_ctz(mask);
+		i += 16;
+	}
+#endif
+
+	while (i < size && HREF_SAFE[src[i]] != 0)
+		i++;
+
+	return i;
+}
+
 void
 houdini_escape_href(struct buf *ob, const uint8_t *src, size_t size)
 {
 	static const char hex_chars[] = "0123456789ABCDEF";
 	size_t  i = 0, org;
-	char hex_str[3];
+	uint8_t *out;
 
 	bufgrow(ob, ESCAPE_GROW_FACTOR(size));
-	hex_str[0] = '%';
 
 	while (i < size) {
 		org = i;
-		while (i < size && HREF_SAFE[src[i]] != 0)
-			i++;
+		i = find_unsafe(src, i, size);
 
 		if (i > org)
 			bufput(ob, src + org, i - org);
@@ -73,18 +114,26 @@ houdini_escape_href(struct buf *ob, const uint8_t *src, size_t size)
 		if (i >= size)
 			break;
 
+		/* room for the longest escape, written in place */
+		if (ob->size + 6 > ob->asize && bufgrow(ob, ob->size + 6) < 0)
+			return;
+
+		out = ob->data + ob->size;
+
 		switch (src[i]) {
 		/* amp appears all the time in URLs, but needs
 		 * HTML-entity escaping to be inside an href */
 		case '&': 
-			BUFPUTSL(ob, "&amp;");
+			memcpy(out, "&amp;", 5);
+			ob->size += 5;
 			break;
 
 		/* the single quote is a valid URL character
 		 * according to the standard; it needs HTML
 		 * entity escaping too */
 		case '\'':
-			BUFPUTSL(ob, "&#x27;");
+			memcpy(out, "&#x27;", 6);
+			ob->size += 6;
 			break;
 		
 		/* the space can be escaped to %20 or a plus
@@ -99,11 +148,12 @@ houdini_escape_href(struct buf *ob, const uint8_t *src, size_t size)
 
 		/* every other character goes with a %XX escaping */
 		default:
-			hex_str[1] = hex_chars[(src[i] >> 4) & 0xF];
-			hex_str[2] = hex_chars[src[i] & 0xF];
-			bufput(ob, hex_str, 3);
+			out[0] = '%';
+			out[1] = hex_chars[(src[i] >> 4) & 0xF];
+			out[2] = hex_chars[src[i] & 0xF];
+			ob->size += 3;
 		}
 
 		i++;
 	}
-}
\ No newline at end of file
+}
@@ -3,6 +3,7 @@
 #include <string.h>
 
 #include "houdini.h"
+#include "simd.h"
 
 #define ESCAPE_GROW_FACTOR(x) (((x) * 12) / 10) /* this is very scientific, yes */
 
@@ -46,6 +47,45 @@ static const char *HTML_ESCAPES[] = {
         "&gt;"
 };
 
+static const size_t HTML_ESCAPES_LEN[] = { 0, 6, 5, 5, 5, 4, 4 };
+
+/* find_escape • returns the offset of the next char that may need an escape */
+/*	the vector path already skips the forward slash outside of secure mode */
+static inline size_t
+find_escape(const uint8_t *src, size_t i, size_t size, int secure)
+{
+#if defined(SD_SIMD_SSE2)
+	const __m128i quot = _mm_set1_epi8('"'), amp = _mm_set1_epi8('&');
+	const __m128i apos = _mm_set1_epi8('\''), slash = _mm_set1_epi8(secure ? '/' : '"');
+	const __m128i lt = _mm_set1_epi8('<'), gt = _mm_set1_epi8('>');
+
+	/* escape-dense text: not worth running the vectors */
+	if (i < size && HTML_ESCAPE_TABLE[src[i]] != 0)
+		return i;
+
+	while (i + 16 <= size) {
+		__m128i block = _mm_loadu_si128((const __m128i *)(src + i));
+		__m128i hits = _mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(block, quot), _mm_cmpeq_epi8(block, amp)),
+			_mm_or_si128(_mm_cmpeq_epi8(block, apos), _mm_cmpeq_epi8(block, slash)));
+		unsigned int mask;
+
+		hits = _mm_or_si128(hits,
+			_mm_or_si128(_mm_cmpeq_epi8(block, lt), _mm_cmpeq_epi8(block, gt)));
+
+		mask = (unsigned int)_mm_movemask_epi8(hits);
+		if (mask)
+			return i + sd_ctz(mask);
+		i += 16;
+	}
+#endif
+
+	while (i < size && HTML_ESCAPE_TABLE[src[i]] == 0)
+		i++;
+
+	return i;
+}
+
 void
 houdini_escape_html0(struct buf *ob, const uint8_t *src, size_t size, int secure)
 {
@@ -55,8 +95,11 @@ houdini_escape_html0(struct buf *ob, const uint8_t *src, size_t size, int secure
 
 	while (i < size) {
 		org = i;
-		while (i < size && (esc = HTML_ESCAPE_TABLE[src[i]]) == 0)
-			i++;
+		i = find_escape(src, i, size, secure);
+
+		/* The forward slash is only escaped in secure mode */
+		while (i < size && src[i] == '/' && !secure)
+			i = find_escape(src, i + 1, size, secure);
 
 		if (i > org)
 			bufput(ob, src + org, i - org);
@@ -65,12 +108,8 @@ houdini_escape_html0(struct buf *ob, const uint8_t *src, size_t size, int secure
 		if (i >= size)
 			break;
 
-		/* The forward slash is only escaped in secure mode */
-		if (src[i] == '/' && !secure) {
-			bufputc(ob, '/');
-		} else {
-			bufputs(ob, HTML_ESCAPES[esc]);
-		}
+		esc = HTML_ESCAPE_TABLE[src[i]];
+		bufput(ob, HTML_ESCAPES[esc], HTML_ESCAPES_LEN[esc]);
 
 		i++;
 	}
@@ -117,10 +117,8 @@ rndr_autolink(struct buf *ob, const struct buf *link, enum mkd_autolink type, vo
 }
 
 static void
-rndr_blockcode(struct buf *ob, const struct buf *text, const struct buf *lang, void *opaque)
+put_blockcode(struct buf *ob, const struct buf *text, const struct buf *lang)
 {
-	if (ob->size) bufputc(ob, '\n');
-
 	if (lang && lang->size) {
 		size_t i, cls;
 		BUFPUTSL(ob, "<pre><code class=\"");
@@ -152,6 +150,13 @@ rndr_blockcode(struct buf *ob, const struct buf *text, const struct buf *lang, v
 	BUFPUTSL(ob, "</code></pre>\n");
 }
 
+static void
+rndr_blockcode(struct buf *ob, const struct buf *text, const struct buf *lang, void *opaque)
+{
+	if (ob->size) bufputc(ob, '\n');
+	put_blockcode(ob, text, lang);
+}
+
 static void
 rndr_blockquote(struct buf *ob, const struct buf *text, void *opaque)
 {
@@ -213,6 +218,15 @@ rndr_linebreak(struct buf *ob, void *opaque)
 	return 1;
 }
 
+static void
+put_header_open(struct buf *ob, int level, struct html_renderopt *options)
+{
+	if (options->flags & HTML_TOC)
+		bufprintf(ob, "<h%d id=\"toc_%d\">", level, options->toc_data.header_count++);
+	else
+		bufprintf(ob, "<h%d>", level);
+}
+
 static void
 rndr_header(struct buf *ob, const struct buf *text, int level, void *opaque)
 {
@@ -221,17 +235,14 @@ rndr_header(struct buf *ob, const struct buf *text, int level, void *opaque)
 	if (ob->size)
 		bufputc(ob, '\n');
 
-	if (options->flags & HTML_TOC)
-		bufprintf(ob, "<h%d id=\"toc_%d\">", level, options->toc_data.header_count++);
-	else
-		bufprintf(ob, "<h%d>", level);
+	put_header_open(ob, level, options);
 
 	if (text) bufput(ob, text->data, text->size);
 	bufprintf(ob, "</h%d>\n", level);
 }
 
 static int
-rndr_link(struct buf *ob, const struct buf *link, const struct buf *title, const struct buf *content, void *opaque)
+put_link_open(struct buf *ob, const struct buf *link, const struct buf *title, void *opaque)
 {
 	struct html_renderopt *options = opaque;
 
@@ -256,6 +267,15 @@ rndr_link(struct buf *ob, const struct buf *link, const struct buf *title, const
 		BUFPUTSL(ob, "\">");
 	}
 
+	return 1;
+}
+
+static int
+rndr_link(struct buf *ob, const struct buf *link, const struct buf *title, const struct buf *content, void *opaque)
+{
+	if (!put_link_open(ob, link, title, opaque))
+		return 0;
+
 	if (content && content->size) bufput(ob, content->data, content->size);
 	BUFPUTSL(ob, "</a>");
 	return 1;
@@ -328,7 +348,7 @@ rndr_paragraph(struct buf *ob, const struct buf *text, void *opaque)
 }
 
 static void
-rndr_raw_block(struct buf *ob, const struct buf *text, void *opaque)
+put_raw_block(struct buf *ob, const struct buf *text, int sep)
 {
 	size_t org, sz;
 	if (!text) return;
@@ -337,11 +357,17 @@ rndr_raw_block(struct buf *ob, const struct buf *text, void *opaque)
 	org = 0;
 	while (org < sz && text->data[org] == '\n') org++;
 	if (org >= sz) return;
-	if (ob->size) bufputc(ob, '\n');
+	if (sep) bufputc(ob, '\n');
 	bufput(ob, text->data + org, sz - org);
 	bufputc(ob, '\n');
 }
 
+static void
+rndr_raw_block(struct buf *ob, const struct buf *text, void *opaque)
+{
+	put_raw_block(ob, text, ob->size != 0);
+}
+
 static int
 rndr_triple_emphasis(struct buf *ob, const struct buf *text, void *opaque)
 {
@@ -435,7 +461,7 @@ rndr_tablerow(struct buf *ob, const struct buf *text, void *opaque)
 }
 
 static void
-rndr_tablecell(struct buf *ob, const struct buf *text, int flags, void *opaque)
+put_cell_open(struct buf *ob, int flags)
 {
 	if (flags & MKD_TABLE_HEADER) {
 		BUFPUTSL(ob, "<th");
@@ -459,6 +485,12 @@ rndr_tablecell(struct buf *ob, const struct buf *text, int flags, void *opaque)
 	default:
 		BUFPUTSL(ob, ">");
 	}
+}
+
+static void
+rndr_tablecell(struct buf *ob, const struct buf *text, int flags, void *opaque)
+{
+	put_cell_open(ob, flags);
 
 	if (text)
 		bufput(ob, text->data, text->size);
@@ -487,6 +519,273 @@ rndr_normal_text(struct buf *ob, const struct buf *text, void *opaque)
 		escape_html(ob, text->data, text->size);
 }
 
+/******************
+ * EVENT RENDERER *
+ ******************/
+
+/* the children of a node are already in ob: its enter opens the tag and
+ * its leave closes it, fixing up the content in place when needed */
+
+static inline void
+event_sep(struct buf *ob, const struct sd_node *node)
+{
+	if (ob->size > node->base)
+		bufputc(ob, '\n');
+}
+
+/* hard_wrap • turns the newlines of a paragraph into line breaks */
+static void
+hard_wrap(struct buf *ob, size_t start, struct html_renderopt *options)
+{
+	const char *br = USE_XHTML(options) ? "<br/>" : "<br>";
+	size_t br_size = strlen(br), breaks = 0, i, j;
+
+	/* a newline ending the paragraph is dropped */
+	if (ob->size > start && ob->data[ob->size - 1] == '\n')
+		ob->size--;
+
+	for (i = start; i < ob->size; ++i)
+		if (ob->data[i] == '\n')
+			breaks++;
+
+	if (!breaks || bufgrow(ob, ob->size + breaks * br_size) < 0)
+		return;
+
+	i = ob->size;
+	j = ob->size = ob->size + breaks * br_size;
+
+	while (i > start) {
+		ob->data[--j] = ob->data[--i];
+		if (ob->data[i] == '\n') {
+			j -= br_size;
+			memcpy(ob->data + j, br, br_size);
+		}
+	}
+}
+
+static int
+event_enter(struct buf *ob, const struct sd_node *node, void *opaque)
+{
+	struct html_renderopt *options = opaque;
+
+	switch (node->type) {
+	case MKDN_BLOCKQUOTE:
+		event_sep(ob, node);
+		BUFPUTSL(ob, "<blockquote>\n");
+		break;
+
+	case MKDN_HEADER:
+		event_sep(ob, node);
+		put_header_open(ob, node->level, options);
+		break;
+
+	case MKDN_LIST:
+		event_sep(ob, node);
+		bufput(ob, node->flags & MKD_LIST_ORDERED ? "<ol>\n" : "<ul>\n", 5);
+		break;
+
+	case MKDN_LISTITEM:
+		BUFPUTSL(ob, "<li>");
+		break;
+
+	case MKDN_PARAGRAPH:
+		event_sep(ob, node);
+		BUFPUTSL(ob, "<p>");
+		break;
+
+	case MKDN_TABLE:
+		event_sep(ob, node);
+		BUFPUTSL(ob, "<table>");
+		break;
+
+	case MKDN_TABLE_HEADER:
+		BUFPUTSL(ob, "<thead>\n");
+		break;
+
+	case MKDN_TABLE_BODY:
+		BUFPUTSL(ob, "<tbody>\n");
+		break;
+
+	case MKDN_TABLE_ROW:
+		BUFPUTSL(ob, "<tr>\n");
+		break;
+
+	case MKDN_TABLE_CELL:
+		put_cell_open(ob, node->flags);
+		break;
+
+	case MKDN_DOUBLE_EMPHASIS:
+		BUFPUTSL(ob, "<strong>");
+		break;
+
+	case MKDN_EMPHASIS:
+		BUFPUTSL(ob, "<em>");
+		break;
+
+	case MKDN_LINK:
+		return put_link_open(ob, node->link, node->title, opaque);
+
+	case MKDN_TRIPLE_EMPHASIS:
+		BUFPUTSL(ob, "<strong><em>");
+		break;
+
+	case MKDN_STRIKETHROUGH:
+		BUFPUTSL(ob, "<del>");
+		break;
+
+	case MKDN_SUPERSCRIPT:
+		BUFPUTSL(ob, "<sup>");
+		break;
+
+	case MKDN_BLOCKCODE:
+		event_sep(ob, node);
+		put_blockcode(ob, node->text, node->lang);
+		break;
+
+	case MKDN_BLOCKHTML:
+		put_raw_block(ob, node->text, ob->size > node->base);
+		break;
+
+	case MKDN_HRULE:
+		event_sep(ob, node);
+		bufputs(ob, USE_XHTML(options) ? "<hr/>\n" : "<hr>\n");
+		break;
+
+	case MKDN_AUTOLINK:
+		ob->size -= node->rewind;
+		return rndr_autolink(ob, node->link, node->autolink, opaque);
+
+	case MKDN_CODESPAN:
+		return rndr_codespan(ob, node->text, opaque);
+
+	case MKDN_IMAGE:
+		if (ob->size > node->base && ob->data[ob->size - 1] == '!')
+			ob->size--;
+		return rndr_image(ob, node->link, node->title, node->text, opaque);
+
+	case MKDN_LINEBREAK:
+		while (ob->size > node->base && ob->data[ob->size - 1] == ' ')
+			ob->size--;
+		return rndr_linebreak(ob, opaque);
+
+	case MKDN_RAW_HTML:
+		return rndr_raw_html(ob, node->text, opaque);
+
+	case MKDN_ENTITY:
+		bufput(ob, node->text->data, node->text->size);
+		break;
+
+	case MKDN_TEXT:
+		rndr_normal_text(ob, node->text, opaque);
+		break;
+
+	default:
+		break;
+	}
+
+	return 1;
+}
+
+static int
+event_leave(struct buf *ob, const struct sd_node *node, void *opaque)
+{
+	struct html_renderopt *options = opaque;
+	size_t i;
+
+	switch (node->type) {
+	case MKDN_BLOCKQUOTE:
+		BUFPUTSL(ob, "</blockquote>\n");
+		break;
+
+	case MKDN_HEADER:
+		bufprintf(ob, "</h%d>\n", node->level);
+		break;
+
+	case MKDN_LIST:
+		bufput(ob, node->flags & MKD_LIST_ORDERED ? "</ol>\n" : "</ul>\n", 6);
+		break;
+
+	case MKDN_LISTITEM:
+		while (ob->size > node->content && ob->data[ob->size - 1] == '\n')
+			ob->size--;
+		BUFPUTSL(ob, "</li>\n");
+		break;
+
+	case MKDN_PARAGRAPH:
+		/* no paragraph around blank text, nor leading spaces in it */
+		for (i = node->content; i < ob->size && isspace(ob->data[i]); ++i);
+
+		if (i == ob->size) {
+			ob->size = node->content - 3;
+			break;
+		}
+
+		if (i > node->content) {
+			memmove(ob->data + node->content, ob->data + i, ob->size - i);
+			ob->size -= i - node->content;
+		}
+
+		if (options->flags & HTML_HARD_WRAP)
+			hard_wrap(ob, node->content, options);
+
+		BUFPUTSL(ob, "</p>\n");
+		break;
+
+	case MKDN_TABLE:
+		BUFPUTSL(ob, "</table>\n");
+		break;
+
+	case MKDN_TABLE_HEADER:
+		BUFPUTSL(ob, "</thead>");
+		break;
+
+	case MKDN_TABLE_BODY:
+		BUFPUTSL(ob, "</tbody>");
+		break;
+
+	case MKDN_TABLE_ROW:
+		BUFPUTSL(ob, "</tr>\n");
+		break;
+
+	case MKDN_TABLE_CELL:
+		if (node->flags & MKD_TABLE_HEADER)
+			BUFPUTSL(ob, "</th>\n");
+		else
+			BUFPUTSL(ob, "</td>\n");
+		break;
+
+	case MKDN_DOUBLE_EMPHASIS:
+	case MKDN_EMPHASIS:
+	case MKDN_TRIPLE_EMPHASIS:
+	case MKDN_STRIKETHROUGH:
+	case MKDN_SUPERSCRIPT:
+		/* empty spans are printed verbatim */
+		if (ob->size == node->content)
+			return 0;
+
+		if (node->type == MKDN_DOUBLE_EMPHASIS)
+			BUFPUTSL(ob, "</strong>");
+		else if (node->type == MKDN_EMPHASIS)
+			BUFPUTSL(ob, "</em>");
+		else if (node->type == MKDN_TRIPLE_EMPHASIS)
+			BUFPUTSL(ob, "</em></strong>");
+		else if (node->type == MKDN_STRIKETHROUGH)
+			BUFPUTSL(ob, "</del>");
+		else
+			BUFPUTSL(ob, "</sup>");
+		break;
+
+	case MKDN_LINK:
+		BUFPUTSL(ob, "</a>");
+		break;
+
+	default:
+		break;
+	}
+
+	return 1;
+}
+
 static void
 toc_header(struct buf *ob, const struct buf *text, int level, void *opaque)
 {
@@ -633,4 +932,25 @@ sdhtml_renderer(struct sd_callbacks *callbacks, struct html_renderopt *options,
 
 	if (render_flags & HTML_SKIP_HTML || render_flags & HTML_ESCAPE)
 		callbacks->blockhtml = NULL;
+}
+
+void
+sdhtml_events(struct sd_events *events, struct html_renderopt *options, unsigned int render_flags)
+{
+	memset(options, 0x0, sizeof(struct html_renderopt));
+	options->flags = render_flags;
+
+	events->enter = event_enter;
+	events->leave = event_leave;
+	events->skip = 0;
+
+	/* the same constructs as the callbacks leave out */
+	if (render_flags & HTML_SKIP_IMAGES)
+		events->skip |= 1 << MKDN_IMAGE;
+
+	if (render_flags & HTML_SKIP_LINKS)
+		events->skip |= (1 << MKDN_LINK) | (1 << MKDN_AUTOLINK);
+
+	if (render_flags & HTML_SKIP_HTML || render_flags & HTML_ESCAPE)
+		events->skip |= 1 << MKDN_BLOCKHTML;
 }
\ No newline at end of file
@@ -63,6 +63,11 @@ sdhtml_is_tag(const uint8_t *tag_data, size_t tag_size, const char *tagname);
 extern void
 sdhtml_renderer(struct sd_callbacks *callbacks, struct html_renderopt *options_ptr, unsigned int render_flags);
 
+/* sdhtml_events • the same HTML as sdhtml_renderer, rendered through
+ * events straight into the output: for sd_config_new_events */
+extern void
+sdhtml_events(struct sd_events *events, struct html_renderopt *options_ptr, unsigned int render_flags);
+
 extern void
 sdhtml_toc_renderer(struct sd_callbacks *callbacks, struct html_renderopt *options_ptr);
 
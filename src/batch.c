@@ -0,0 +1,259 @@
+/* batch.c - rendering many small documents on reusable workers */
+
+/*
+ * Copyright (c) 2026, agent
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "markdown.h"
+#include "pool.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BATCH_UNIT 4096	/* first size of the output buffers */
+
+/* batch_worker: a thread's context, and everything it rendered */
+struct batch_worker {
+	struct sd_markdown *md;
+	struct buf *work;	/* output of the document being rendered */
+	struct buf *out;	/* outputs of the call so far, back to back */
+};
+
+/* batch_item: where the output of one document was left */
+struct batch_item {
+	unsigned int worker;
+	size_t offset, size;
+	int status;
+};
+
+struct sd_batch {
+	const struct sd_config *cfg;
+	void *opaque;
+	unsigned int nthreads;
+	size_t max_bytes;	/* of the outputs of a worker */
+	struct batch_worker *workers;
+	struct batch_item *items;
+	size_t items_size;
+
+	const struct sd_slice *docs;	/* of the call in progress */
+	struct buf **targets;	/* the caller's outputs, or NULL */
+};
+
+/* the per-document ceiling is the renderer's business: the buffers
+ * gathering all the outputs of a worker may grow past it, up to
+ * max_bytes, which batch_doc keeps them to */
+static void *
+batch_realloc(void *opaque, void *ptr, size_t old_size, size_t new_size)
+{
+	return realloc(ptr, new_size);
+}
+
+static void
+batch_free(void *opaque, void *ptr, size_t size)
+{
+	free(ptr);
+}
+
+static const struct buf_allocator batch_heap = { batch_realloc, batch_free, NULL };
+
+/* batch_doc • pool task rendering one document */
+/*	into the buffer the caller gave for it, or on its own and then after
+ *	the outputs the worker rendered before: the renderers see where the
+ *	output starts, so documents are not rendered back to back */
+static void
+batch_doc(void *opaque, size_t index, unsigned int id)
+{
+	struct sd_batch *batch = opaque;
+	struct batch_worker *worker = &batch->workers[id];
+	struct batch_item *item = &batch->items[index];
+	const struct sd_slice *doc = &batch->docs[index];
+	struct buf *ob;
+	size_t need;
+
+	if (!worker->md) {
+		worker->md = sd_markdown_new_context(batch->cfg, batch->opaque);
+		worker->work = bufnew(BATCH_UNIT);
+		worker->out = bufnew_with(BATCH_UNIT, &batch_heap);
+	}
+
+	item->worker = id;
+	item->offset = item->size = 0;
+	item->status = MKD_ENOMEM;
+
+	if (!worker->md)
+		return;
+
+	if (batch->targets) {
+		ob = batch->targets[index];
+		item->status = sd_markdown_render(ob, doc->data, doc->size, worker->md);
+		return;
+	}
+
+	if (!worker->work || !worker->out)
+		return;
+
+	worker->work->size = 0;
+	item->status = sd_markdown_render(worker->work, doc->data, doc->size, worker->md);
+
+	/* doubling, but never past max_bytes */
+	if (worker->work->size > batch->max_bytes - worker->out->size) {
+		item->status = MKD_ENOMEM;
+		return;
+	}
+
+	need = worker->out->size + worker->work->size;
+	if (need > worker->out->asize) {
+		size_t grow = worker->out->asize * 2;
+		bufgrow(worker->out, (grow > need && grow <= batch->max_bytes) ? grow : need);
+	}
+
+	item->offset = worker->out->size;
+	bufput(worker->out, worker->work->data, worker->work->size);
+	item->size = worker->out->size - item->offset;
+
+	if (item->size < worker->work->size)
+		item->status = MKD_ENOMEM;
+}
+
+/* batch_run • renders count documents on the workers, into targets when
+ * given; returns MKD_OK or the status of the first document that failed */
+static int
+batch_run(struct sd_batch *batch, const struct sd_slice *docs,
+	struct buf **targets, int *status, size_t count)
+{
+	size_t i;
+	unsigned int w;
+	int result = MKD_OK;
+
+	if (count > batch->items_size) {
+		struct batch_item *items = realloc(batch->items, count * sizeof(struct batch_item));
+		if (!items)
+			return MKD_ENOMEM;
+
+		batch->items = items;
+		batch->items_size = count;
+	}
+
+	for (w = 0; w < batch->nthreads; ++w)
+		if (batch->workers[w].out)
+			batch->workers[w].out->size = 0;
+
+	batch->docs = docs;
+	batch->targets = targets;
+	pool_run(batch->nthreads, count, batch_doc, batch);
+	batch->targets = NULL;
+
+	for (i = 0; i < count; ++i) {
+		if (status)
+			status[i] = batch->items[i].status;
+		if (result == MKD_OK)
+			result = batch->items[i].status;
+	}
+
+	return result;
+}
+
+struct sd_batch *
+sd_batch_new(const struct sd_config *cfg, void *opaque, unsigned int nthreads,
+	size_t max_bytes)
+{
+	struct sd_batch *batch;
+
+	assert(cfg);
+
+	if (nthreads == 0)
+		nthreads = 1;
+
+	batch = calloc(1, sizeof(struct sd_batch));
+	if (!batch)
+		return NULL;
+
+	batch->cfg = cfg;
+	batch->opaque = opaque;
+	batch->nthreads = nthreads;
+	batch->max_bytes = max_bytes ? max_bytes : BUFFER_MAX_ALLOC_SIZE;
+	batch->workers = calloc(nthreads, sizeof(struct batch_worker));
+
+	if (!batch->workers) {
+		sd_batch_free(batch);
+		return NULL;
+	}
+
+	return batch;
+}
+
+int
+sd_batch_render(struct sd_batch *batch, const struct sd_slice *docs,
+	struct sd_slice *outputs, int *status, size_t count)
+{
+	size_t i;
+	int result;
+
+	result = batch_run(batch, docs, NULL, status, count);
+	if (count > batch->items_size)
+		return result;
+
+	/* the outputs stay where their worker rendered them */
+	for (i = 0; i < count; ++i) {
+		const struct batch_item *item = &batch->items[i];
+		const struct buf *out = batch->workers[item->worker].out;
+
+		outputs[i].data = out ? out->data + item->offset : NULL;
+		outputs[i].size = item->size;
+	}
+
+	return result;
+}
+
+int
+sd_markdown_render_batch(const struct sd_config *cfg, void *opaque,
+	const struct sd_slice *docs, struct buf **outputs, int *status,
+	size_t count, unsigned int nthreads)
+{
+	struct sd_batch *batch;
+	int result;
+
+	/* the outputs go to the caller's buffers, not to the workers' */
+	batch = sd_batch_new(cfg, opaque, nthreads, 0);
+	if (!batch)
+		return MKD_ENOMEM;
+
+	result = batch_run(batch, docs, outputs, status, count);
+	sd_batch_free(batch);
+	return result;
+}
+
+void
+sd_batch_free(struct sd_batch *batch)
+{
+	unsigned int w;
+
+	if (!batch)
+		return;
+
+	for (w = 0; batch->workers && w < batch->nthreads; ++w) {
+		if (batch->workers[w].md)
+			sd_markdown_free(batch->workers[w].md);
+		bufrelease(batch->workers[w].work);
+		bufrelease(batch->workers[w].out);
+	}
+
+	free(batch->workers);
+	free(batch->items);
+	free(batch);
+}
+
+/* vim: set filetype=c: */
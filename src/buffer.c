@@ -16,7 +16,8 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
-#define BUFFER_MAX_ALLOC_SIZE (1024 * 1024 * 16) //16mb
+#define BUFFER_GROW_CAP (1024 * 1024) //1mb
+#define ARENA_ALIGN(x) (((x) + 15) & ~(size_t)15)
 
 #include "buffer.h"
 
@@ -32,6 +33,34 @@
 #	define _buf_vsnprintf vsnprintf
 #endif
 
+/* buf_arena_chunk: one block of arena memory, data follows the header */
+struct buf_arena_chunk {
+	struct buf_arena_chunk *next;
+	size_t size;	/* usable bytes after the header */
+	size_t used;	/* bytes handed out so far */
+};
+
+#define ARENA_HEADER ARENA_ALIGN(sizeof(struct buf_arena_chunk))
+#define CHUNK_DATA(c) ((uint8_t *)(c) + ARENA_HEADER)
+
+void *
+bufmem_alloc(const struct buf_allocator *alloc, size_t size)
+{
+	if (!alloc)
+		return malloc(size);
+
+	return alloc->realloc(alloc->opaque, NULL, 0, size);
+}
+
+void
+bufmem_free(const struct buf_allocator *alloc, void *ptr, size_t size)
+{
+	if (!alloc)
+		free(ptr);
+	else if (ptr)
+		alloc->free(alloc->opaque, ptr, size);
+}
+
 int
 bufprefix(const struct buf *buf, const char *prefix)
 {
@@ -53,22 +82,49 @@ bufprefix(const struct buf *buf, const char *prefix)
 int
 bufgrow(struct buf *buf, size_t neosz)
 {
-	size_t neoasz;
+	size_t neoasz, step;
 	void *neodata;
 
 	assert(buf && buf->unit);
 
-	if (neosz > BUFFER_MAX_ALLOC_SIZE)
+	/* hooked buffers leave the size ceiling to their allocator */
+	if (neosz > BUFFER_MAX_ALLOC_SIZE && !buf->alloc)
 		return BUF_ENOMEM;
 
 	if (buf->asize >= neosz)
 		return BUF_OK;
 
-	neoasz = buf->asize + buf->unit;
-	while (neoasz < neosz)
-		neoasz += buf->unit;
+	switch (buf->growth) {
+	case BUF_GROW_DOUBLE:
+		step = buf->asize;
+		break;
+
+	case BUF_GROW_HALF:
+		step = buf->asize >> 1;
+		break;
+
+	case BUF_GROW_CAPPED:
+		step = buf->asize < BUFFER_GROW_CAP ? buf->asize : BUFFER_GROW_CAP;
+		break;
+
+	default:
+		step = 0;
+	}
+
+	/* whole units past the current size, enough to fit neosz */
+	neoasz = buf->asize + ((neosz - buf->asize + buf->unit - 1) / buf->unit) * buf->unit;
+
+	if (neoasz < buf->asize + step)
+		neoasz = buf->asize + step;
+
+	if (neoasz > BUFFER_MAX_ALLOC_SIZE && neosz <= BUFFER_MAX_ALLOC_SIZE)
+		neoasz = BUFFER_MAX_ALLOC_SIZE;
+
+	if (buf->alloc)
+		neodata = buf->alloc->realloc(buf->alloc->opaque, buf->data, buf->asize, neoasz);
+	else
+		neodata = realloc(buf->data, neoasz);
 
-	neodata = realloc(buf->data, neoasz);
 	if (!neodata)
 		return BUF_ENOMEM;
 
@@ -81,14 +137,23 @@ bufgrow(struct buf *buf, size_t neosz)
 /* bufnew: allocation of a new buffer */
 struct buf *
 bufnew(size_t unit)
+{
+	return bufnew_with(unit, NULL);
+}
+
+/* bufnew_with: allocation of a new buffer through the given hooks */
+struct buf *
+bufnew_with(size_t unit, const struct buf_allocator *alloc)
 {
 	struct buf *ret;
-	ret = malloc(sizeof (struct buf));
+	ret = bufmem_alloc(alloc, sizeof (struct buf));
 
 	if (ret) {
 		ret->data = 0;
 		ret->size = ret->asize = 0;
 		ret->unit = unit;
+		ret->alloc = alloc;
+		ret->growth = BUF_GROW_LINEAR;
 	}
 	return ret;
 }
@@ -192,8 +257,8 @@ bufrelease(struct buf *buf)
 	if (!buf)
 		return;
 
-	free(buf->data);
-	free(buf);
+	bufmem_free(buf->alloc, buf->data, buf->asize);
+	bufmem_free(buf->alloc, buf, sizeof (struct buf));
 }
 
 
@@ -204,7 +269,7 @@ bufreset(struct buf *buf)
 	if (!buf)
 		return;
 
-	free(buf->data);
+	bufmem_free(buf->alloc, buf->data, buf->asize);
 	buf->data = NULL;
 	buf->size = buf->asize = 0;
 }
@@ -223,3 +288,146 @@ bufslurp(struct buf *buf, size_t len)
 	buf->size -= len;
 	memmove(buf->data, buf->data + len, buf->size);
 }
+
+/* bufhash: 64-bit hash of raw data, for in-memory tables only */
+/*   MurmurHash64A, eight bytes at a time in host order */
+uint64_t
+bufhash(const void *data, size_t size, uint64_t seed)
+{
+	static const uint64_t m = UINT64_C(0xc6a4a7935bd1e995);
+	const uint8_t *p = data;
+	uint64_t h = seed ^ ((uint64_t)size * m), k;
+
+	for (; size >= 8; p += 8, size -= 8) {
+		memcpy(&k, p, 8);
+		k *= m;
+		k ^= k >> 47;
+		k *= m;
+		h ^= k;
+		h *= m;
+	}
+
+	if (size) {
+		k = 0;
+		while (size--)
+			k = (k << 8) | p[size];
+		h ^= k;
+		h *= m;
+	}
+
+	h ^= h >> 47;
+	h *= m;
+	h ^= h >> 47;
+	return h;
+}
+
+/* arena_realloc: bump allocation, growing in place the latest block */
+static void *
+arena_realloc(void *opaque, void *ptr, size_t old_size, size_t new_size)
+{
+	struct buf_arena *arena = opaque;
+	struct buf_arena_chunk *chunk = arena->cur;
+	uint8_t *neodata;
+
+	/* the last block handed out can be extended where it lies */
+	if (ptr && chunk &&
+		(uint8_t *)ptr + ARENA_ALIGN(old_size) == CHUNK_DATA(chunk) + chunk->used &&
+		(size_t)((uint8_t *)ptr - CHUNK_DATA(chunk)) + new_size <= chunk->size) {
+		chunk->used = ((uint8_t *)ptr - CHUNK_DATA(chunk)) + ARENA_ALIGN(new_size);
+		return ptr;
+	}
+
+	new_size = ARENA_ALIGN(new_size);
+
+	/* looking for the first kept chunk with enough room */
+	while (chunk && chunk->used + new_size > chunk->size) {
+		chunk = chunk->next;
+		if (chunk)
+			chunk->used = 0;
+	}
+
+	if (!chunk) {
+		size_t chunk_size = arena->chunk_size;
+
+		if (chunk_size < new_size)
+			chunk_size = new_size;
+
+		chunk = malloc(ARENA_HEADER + chunk_size);
+		if (!chunk)
+			return NULL;
+
+		chunk->next = NULL;
+		chunk->size = chunk_size;
+		chunk->used = 0;
+
+		if (arena->cur) {
+			chunk->next = arena->cur->next;
+			arena->cur->next = chunk;
+		} else {
+			arena->head = chunk;
+		}
+	}
+
+	arena->cur = chunk;
+	neodata = CHUNK_DATA(chunk) + chunk->used;
+	chunk->used += new_size;
+
+	if (ptr)
+		memcpy(neodata, ptr, old_size < new_size ? old_size : new_size);
+
+	return neodata;
+}
+
+/* arena_free: only the latest block can be given back before a reset */
+static void
+arena_free(void *opaque, void *ptr, size_t size)
+{
+	struct buf_arena *arena = opaque;
+	struct buf_arena_chunk *chunk = arena->cur;
+
+	if (chunk && (uint8_t *)ptr + ARENA_ALIGN(size) == CHUNK_DATA(chunk) + chunk->used)
+		chunk->used -= ARENA_ALIGN(size);
+}
+
+/* bufarena_init: setup of an empty arena allocating chunk_size blocks */
+int
+bufarena_init(struct buf_arena *arena, size_t chunk_size)
+{
+	assert(arena);
+
+	arena->alloc.realloc = arena_realloc;
+	arena->alloc.free = arena_free;
+	arena->alloc.opaque = arena;
+	arena->head = arena->cur = NULL;
+	arena->chunk_size = chunk_size ? chunk_size : 4096;
+
+	return BUF_OK;
+}
+
+/* bufarena_reset: releases every allocation, keeping the chunks around */
+void
+bufarena_reset(struct buf_arena *arena)
+{
+	if (!arena || !arena->head)
+		return;
+
+	arena->cur = arena->head;
+	arena->cur->used = 0;
+}
+
+/* bufarena_free: gives all the chunks back to the heap */
+void
+bufarena_free(struct buf_arena *arena)
+{
+	struct buf_arena_chunk *chunk, *next;
+
+	if (!arena)
+		return;
+
+	for (chunk = arena->head; chunk; chunk = next) {
+		next = chunk->next;
+		free(chunk);
+	}
+
+	arena->head = arena->cur = NULL;
+}
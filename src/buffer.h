@@ -32,17 +32,48 @@ extern "C" {
 #define inline
 #endif
 
+/* BUFFER_MAX_ALLOC_SIZE: largest size bufgrow grants a libc-backed buffer */
+#define BUFFER_MAX_ALLOC_SIZE (1024 * 1024 * 16) //16mb
+
 typedef enum {
 	BUF_OK = 0,
 	BUF_ENOMEM = -1,
 } buferror_t;
 
+/* bufgrowth_t: policy used by bufgrow to pick the new allocated size */
+typedef enum {
+	BUF_GROW_LINEAR = 0,	/* smallest multiple of unit that fits */
+	BUF_GROW_DOUBLE,	/* at least twice the current size */
+	BUF_GROW_HALF,	/* at least 1.5 times the current size */
+	BUF_GROW_CAPPED,	/* doubling, by BUFFER_GROW_CAP steps at most */
+} bufgrowth_t;
+
+/* struct buf_allocator: memory hooks used by a buffer */
+/*   realloc is called with a NULL ptr for fresh allocations */
+struct buf_allocator {
+	void *(*realloc)(void *opaque, void *ptr, size_t old_size, size_t new_size);
+	void (*free)(void *opaque, void *ptr, size_t size);
+	void *opaque;
+};
+
 /* struct buf: character array buffer */
 struct buf {
 	uint8_t *data;		/* actual character data */
 	size_t size;	/* size of the string */
 	size_t asize;	/* allocated size (0 = volatile buffer) */
 	size_t unit;	/* reallocation unit size (0 = read-only buffer) */
+	const struct buf_allocator *alloc;	/* memory hooks (NULL = libc heap) */
+	bufgrowth_t growth;	/* reallocation policy */
+};
+
+/* struct buf_arena: bump allocator released in a single step */
+struct buf_arena_chunk;
+
+struct buf_arena {
+	struct buf_allocator alloc;	/* hooks handed out to the buffers */
+	struct buf_arena_chunk *head;	/* first chunk, kept across resets */
+	struct buf_arena_chunk *cur;	/* chunk currently bump-allocated */
+	size_t chunk_size;	/* minimal size of a new chunk */
 };
 
 /* CONST_BUF: global buffer from a string litteral */
@@ -63,6 +94,15 @@ int bufgrow(struct buf *, size_t);
 /* bufnew: allocation of a new buffer */
 struct buf *bufnew(size_t) __attribute__ ((malloc));
 
+/* bufnew_with: allocation of a new buffer through the given hooks */
+struct buf *bufnew_with(size_t, const struct buf_allocator *) __attribute__ ((malloc));
+
+/* bufmem_alloc: raw allocation through buffer hooks (NULL = libc heap) */
+void *bufmem_alloc(const struct buf_allocator *, size_t) __attribute__ ((malloc));
+
+/* bufmem_free: raw deallocation through buffer hooks */
+void bufmem_free(const struct buf_allocator *, void *, size_t);
+
 /* bufnullterm: NUL-termination of the string array (making a C-string) */
 const char *bufcstr(struct buf *);
 
@@ -90,6 +130,18 @@ void bufslurp(struct buf *, size_t);
 /* bufprintf: formatted printing to a buffer */
 void bufprintf(struct buf *, const char *, ...) __attribute__ ((format (printf, 2, 3)));
 
+/* bufhash: 64-bit hash of raw data, for in-memory tables only */
+uint64_t bufhash(const void *, size_t, uint64_t seed);
+
+/* bufarena_init: setup of an empty arena allocating chunk_size blocks */
+int bufarena_init(struct buf_arena *, size_t chunk_size);
+
+/* bufarena_reset: releases every allocation, keeping the chunks around */
+void bufarena_reset(struct buf_arena *);
+
+/* bufarena_free: gives all the chunks back to the heap */
+void bufarena_free(struct buf_arena *);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,243 @@
+/* cache.c - render outputs kept by content */
+
+/*
+ * Copyright (c) 2026, agent
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "markdown.h"
+#include "cache.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define CACHE_MIN_BUCKETS 64
+
+#define ENTRY_BYTES(e) (sizeof(struct cache_entry) + (e)->key_size + (e)->value_size)
+
+/* cache_unlink • takes an entry out of the use order */
+static void
+cache_unlink(struct sd_cache *cache, struct cache_entry *entry)
+{
+	if (entry->newer)
+		entry->newer->older = entry->older;
+	else
+		cache->newest = entry->older;
+
+	if (entry->older)
+		entry->older->newer = entry->newer;
+	else
+		cache->oldest = entry->newer;
+}
+
+/* cache_push • makes an entry the most recently used */
+static void
+cache_push(struct sd_cache *cache, struct cache_entry *entry)
+{
+	entry->newer = NULL;
+	entry->older = cache->newest;
+
+	if (cache->newest)
+		cache->newest->newer = entry;
+	else
+		cache->oldest = entry;
+
+	cache->newest = entry;
+}
+
+/* cache_drop • removes an entry and gives its memory back */
+static void
+cache_drop(struct sd_cache *cache, struct cache_entry *entry)
+{
+	struct cache_entry **slot = &cache->buckets[entry->hash & (cache->bucket_count - 1)];
+
+	while (*slot != entry)
+		slot = &(*slot)->next;
+
+	*slot = entry->next;
+	cache_unlink(cache, entry);
+
+	cache->stats.entries--;
+	cache->stats.bytes -= ENTRY_BYTES(entry);
+	free(entry);
+}
+
+/* cache_rehash • doubles the buckets once there are more entries */
+static void
+cache_rehash(struct sd_cache *cache)
+{
+	struct cache_entry **buckets, *entry, *next;
+	size_t count = cache->bucket_count * 2, i;
+
+	buckets = calloc(count, sizeof(struct cache_entry *));
+	if (!buckets)
+		return;
+
+	for (i = 0; i < cache->bucket_count; ++i) {
+		for (entry = cache->buckets[i]; entry; entry = next) {
+			next = entry->next;
+			entry->next = buckets[entry->hash & (count - 1)];
+			buckets[entry->hash & (count - 1)] = entry;
+		}
+	}
+
+	free(cache->buckets);
+	cache->buckets = buckets;
+	cache->bucket_count = count;
+}
+
+/* cache_next • next entry of the given hash and settings after prev */
+struct cache_entry *
+cache_next(struct sd_cache *cache, struct cache_entry *prev, uint64_t hash, uint64_t settings)
+{
+	struct cache_entry *entry;
+
+	entry = prev ? prev->next : cache->buckets[hash & (cache->bucket_count - 1)];
+
+	while (entry && (entry->hash != hash || entry->settings != settings))
+		entry = entry->next;
+
+	return entry;
+}
+
+/* cache_touch • makes an entry the most recently used */
+void
+cache_touch(struct sd_cache *cache, struct cache_entry *entry)
+{
+	cache_unlink(cache, entry);
+	cache_push(cache, entry);
+}
+
+/* cache_insert • adds an entry, making room for it */
+void
+cache_insert(struct sd_cache *cache, uint64_t hash, uint64_t settings,
+	const uint8_t *key, size_t key_size, const uint8_t *value, size_t value_size)
+{
+	struct cache_entry *entry;
+	size_t bytes = sizeof(struct cache_entry) + key_size + value_size;
+
+	if (bytes > cache->max_bytes)
+		return;
+
+	while (cache->oldest && cache->stats.bytes + bytes > cache->max_bytes) {
+		cache_drop(cache, cache->oldest);
+		cache->stats.evictions++;
+	}
+
+	entry = malloc(bytes);
+	if (!entry)
+		return;
+
+	entry->hash = hash;
+	entry->settings = settings;
+	entry->data = (uint8_t *)(entry + 1);
+	entry->key_size = key_size;
+	entry->value_size = value_size;
+	memcpy(entry->data, key, key_size);
+	memcpy(entry->data + key_size, value, value_size);
+
+	entry->next = cache->buckets[hash & (cache->bucket_count - 1)];
+	cache->buckets[hash & (cache->bucket_count - 1)] = entry;
+	cache_push(cache, entry);
+
+	cache->stats.entries++;
+	cache->stats.bytes += bytes;
+
+	if (cache->stats.entries > cache->bucket_count)
+		cache_rehash(cache);
+}
+
+struct sd_cache *
+sd_cache_new(size_t max_bytes)
+{
+	struct sd_cache *cache;
+
+	cache = calloc(1, sizeof(struct sd_cache));
+	if (!cache)
+		return NULL;
+
+	cache->bucket_count = CACHE_MIN_BUCKETS;
+	cache->buckets = calloc(cache->bucket_count, sizeof(struct cache_entry *));
+	cache->max_bytes = max_bytes;
+
+	if (!cache->buckets) {
+		free(cache);
+		return NULL;
+	}
+
+	return cache;
+}
+
+int
+sd_cache_render(struct sd_cache *cache, struct buf *ob, const uint8_t *document,
+	size_t doc_size, struct sd_markdown *md, unsigned int render_flags)
+{
+	struct cache_entry *entry = NULL;
+	uint64_t settings, hash;
+	size_t start = ob->size;
+	int status, seed;
+
+	/* the renderers look back at ob, the HTML one puts a newline before
+	 * the first block when it is not empty: entries keep its last byte */
+	seed = start ? ob->data[start - 1] : -1;
+	settings = CACHE_SETTINGS(md, render_flags) ^ ((uint64_t)(seed + 1) << 56);
+	hash = bufhash(document, doc_size, settings);
+
+	/* the hash only picks the candidates: the bytes are compared too */
+	while ((entry = cache_next(cache, entry, hash, settings)) != NULL)
+		if (entry->key_size == doc_size && memcmp(entry->data, document, doc_size) == 0)
+			break;
+
+	if (entry) {
+		cache->stats.hits++;
+		cache_touch(cache, entry);
+
+		bufput(ob, CACHE_VALUE(entry), entry->value_size);
+		return ob->size - start == entry->value_size ? MKD_OK : MKD_ENOMEM;
+	}
+
+	cache->stats.misses++;
+	status = sd_markdown_render(ob, document, doc_size, md);
+
+	if (status == MKD_OK)
+		cache_insert(cache, hash, settings, document, doc_size, ob->data + start, ob->size - start);
+
+	return status;
+}
+
+void
+sd_cache_stats(const struct sd_cache *cache, struct sd_cache_stats *stats)
+{
+	*stats = cache->stats;
+}
+
+void
+sd_cache_clear(struct sd_cache *cache)
+{
+	while (cache->oldest)
+		cache_drop(cache, cache->oldest);
+}
+
+void
+sd_cache_free(struct sd_cache *cache)
+{
+	if (!cache)
+		return;
+
+	sd_cache_clear(cache);
+	free(cache->buckets);
+	free(cache);
+}
+
+/* vim: set filetype=c: */
@@ -0,0 +1,74 @@
+/* cache.h - entries of the render caches */
+
+/*
+ * Copyright (c) 2026, agent
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef CACHE_H__
+#define CACHE_H__
+
+#include "markdown.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* CACHE_SETTINGS: what the output depends on besides the document */
+#define CACHE_SETTINGS(md, render_flags) \
+	(sd_markdown_config_hash(md) ^ ((uint64_t)(render_flags) << 1))
+
+/* cache_entry: a key, a whole document or a block and its context,
+ * and the output rendered from it */
+struct cache_entry {
+	uint64_t hash;	/* picks the bucket, seeded with settings */
+	uint64_t settings;
+	uint8_t *data;	/* key then value, stored right after the struct */
+	size_t key_size;
+	size_t value_size;
+
+	struct cache_entry *next;	/* in the same bucket */
+	struct cache_entry *newer, *older;	/* in use order */
+};
+
+#define CACHE_VALUE(e) ((e)->data + (e)->key_size)
+
+struct sd_cache {
+	struct cache_entry **buckets;
+	size_t bucket_count;	/* a power of two */
+	struct cache_entry *newest, *oldest;
+	size_t max_bytes;
+	struct sd_cache_stats stats;
+};
+
+/* cache_next • next entry of the given hash and settings after prev,
+ * NULL starting over; the keys are for the caller to compare */
+struct cache_entry *
+cache_next(struct sd_cache *cache, struct cache_entry *prev, uint64_t hash, uint64_t settings);
+
+/* cache_touch • makes an entry the most recently used */
+void
+cache_touch(struct sd_cache *cache, struct cache_entry *entry);
+
+/* cache_insert • adds an entry, evicting the least recently used ones
+ * to stay within the byte budget; entries too large for it are left out */
+void
+cache_insert(struct sd_cache *cache, uint64_t hash, uint64_t settings,
+	const uint8_t *key, size_t key_size, const uint8_t *value, size_t value_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
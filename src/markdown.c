@@ -19,6 +19,9 @@
 
 #include "markdown.h"
 #include "stack.h"
+#include "simd.h"
+#include "pool.h"
+#include "cache.h"
 
 #include <assert.h>
 #include <string.h>
@@ -29,13 +32,29 @@
 #define strncasecmp	_strnicmp
 #endif
 
-#define REF_TABLE_SIZE 8
+#ifdef SUNDOWN_STATS
+#  ifdef _WIN32
+#    include <windows.h>
+#  else
+#    include <time.h>
+#  endif
+#endif
+
+#define REF_TABLE_MIN 8	/* smallest slot count of the reference table */
 
 #define BUFFER_BLOCK 0
 #define BUFFER_SPAN 1
 
 #define MKD_LI_END 8	/* internal list flag */
 
+#define SINK_UNIT 4096	/* pending output flushed at block boundaries */
+#define TEXT_KEEP (64 * 1024)	/* largest first pass copy kept for the next render */
+
+#define SPLIT_MIN_CHUNK (64 * 1024)	/* smallest slice worth its own task */
+#define SPLIT_CHUNKS 4	/* slices per thread, to even out the load */
+#define SPLIT_RESYNC 16	/* blocks rendered one by one to catch up with a slice */
+#define CACHE_BLOCK_MAX (64 * 1024)	/* largest text a cached block may depend on */
+
 #define gperf_case_strncmp(s1, s2, n) strncasecmp(s1, s2, n)
 #define GPERF_DOWNCASE 1
 #define GPERF_CASE_STRNCMP 1
@@ -48,11 +67,66 @@
 /* link_ref: reference to a link */
 struct link_ref {
 	unsigned int id;
+	uint8_t *name;	/* as written, stored right after the struct */
+	size_t name_size;
 
 	struct buf *link;
 	struct buf *title;
 
-	struct link_ref *next;
+	struct link_ref *next;	/* previously defined reference */
+};
+
+/* emph_span: failed emphasis searches within one parse_inline call */
+/*	failed[i] has bit N set when no closer of kind N follows data[i] */
+struct emph_span {
+	uint8_t *data;
+	size_t size;
+	uint8_t *failed;
+};
+
+/* html_span: failed closing tag searches within one parse_block call */
+/*	failed[N] is the earliest block start where the search for curtag */
+/*	with start_of_line = N came up empty (NULL = not searched yet) */
+#define HTML_SPAN_TAGS 24	/* one slot per tag in html_blocks.h */
+
+struct html_span {
+	uint8_t *end;
+	size_t count;
+	struct {
+		const char *tag;
+		uint8_t *failed[2];
+	} tags[HTML_SPAN_TAGS];
+};
+
+/* block_ref: a reference looked up by a cached block, its name follows */
+struct block_ref {
+	size_t name_size;
+	uint64_t hash;	/* ref_hash of what the lookup gave */
+};
+
+/* block_key: key of a cached top-level block, followed by the text
+ * it depends on and its block_ref */
+struct block_key {
+	size_t size;	/* of the block itself */
+	size_t span;	/* text from the block start its parse may look at */
+	size_t refs_size;
+	int seed;	/* last output byte before it, -1 for none */
+	int at_end;	/* the span runs to the end of the text */
+};
+
+/* line_info: one line of the text handed to the top-level parse_block */
+struct line_info {
+	size_t end;	/* offset just past the '\n' */
+	uint8_t indent;	/* leading spaces, capped at 255 */
+	uint8_t first;	/* first byte past them, '\n' on blank lines */
+	uint8_t pipe;	/* whether a '|' shows up on the line */
+};
+
+/* mem_tracker: allocator hooks charging a parser's memory budget */
+struct mem_tracker {
+	struct buf_allocator hooks;
+	const struct buf_allocator *parent;	/* NULL = libc heap */
+	struct sd_markdown *md;
 };
 
 /* char_trigger: function pointer to render active chars */
@@ -105,23 +179,198 @@ static char_trigger markdown_char_ptrs[] = {
 	&char_superscript,
 };
 
+/* config • what a parser is set up with, never written to by a render */
+struct sd_config {
+	struct sd_callbacks	cb;
+	struct sd_events events;	/* rendering through events when enter is set */
+	uint8_t active_char[256];
+	uint8_t active_list[16];	/* the active chars, for vector compares */
+	size_t active_count;
+	uint8_t active_lo[16];	/* low nibble -> bit per high nibble */
+	uint8_t active_hi[16];	/* high nibble -> its bit */
+	unsigned int ext_flags;
+	size_t max_nesting;
+	uint64_t hash;	/* of the callbacks, extensions and nesting limit */
+};
+
 /* render • structure containing one particular render */
 struct sd_markdown {
-	struct sd_callbacks	cb;
+	const struct sd_config *cfg;
+	struct sd_config *own_cfg;	/* set up by sd_markdown_new */
 	void *opaque;
 
-	struct link_ref *refs[REF_TABLE_SIZE];
-	uint8_t active_char[256];
+	struct link_ref *ref_list;	/* every reference, latest first */
+	struct link_ref **refs;	/* open-addressing table over ref_list */
+	size_t refs_size;	/* slot count, a power of two */
 	struct stack work_bufs[2];
-	unsigned int ext_flags;
-	size_t max_nesting;
+	const struct buf_allocator *alloc;
+	struct buf_arena arena;
+	struct mem_tracker mem_work;
+	struct mem_tracker mem_out;
+	size_t mem_used;
+	size_t mem_peak;
+	size_t mem_limit;
+	int status;
+	sd_output_sink sink;
+	void *sink_opaque;
+	int in_place;	/* the text is the caller's, or shared by threads */
+	struct buf *quote_work;	/* copy of a blockquote read in place */
+	struct buf *text_work;	/* first pass copy of the last render */
 	int in_link_body;
+	size_t node_base;	/* where the content of the open node starts */
+	struct emph_span *emph_span;
+	struct html_span *html_span;
+	size_t html_reach;	/* furthest byte of the text an HTML block search saw */
+	struct buf *line_work;	/* line table filled by the first pass */
+	int line_stop;	/* the table could not grow any further */
+	struct line_info *lines;
+	size_t line_count;
+	const uint8_t *line_data;
+	size_t line_size;
+	size_t line_cur;	/* last line looked up */
+	unsigned int threads;	/* top-level blocks rendered side by side */
+	struct sd_cache *cache;	/* top-level blocks rendered before */
+	uint64_t cache_settings;
+	uint64_t cache_hash;	/* of the first line of the block being parsed */
+	int cache_block;	/* the block being parsed may go in the cache */
+	struct buf *cache_refs;	/* block_ref of every reference it looked up */
+	struct buf *cache_key;
+#ifdef SUNDOWN_STATS
+	struct sd_render_stats *stats;	/* filled by each render, or NULL */
+#endif
 };
 
+/*******************
+ * RENDER COUNTERS *
+ *******************/
+
+/* without SUNDOWN_STATS the counters are not even evaluated: the calls
+ * they wrap are left bare and the rest goes away */
+#ifdef SUNDOWN_STATS
+
+#define STAT(md, field, n) \
+	do { if ((md)->stats) (md)->stats->field += (n); } while (0)
+
+#define STAT_BLOCK(md, kind, call) stat_block((md), (kind), (call))
+#define STAT_TRIGGER(md, action, call) stat_trigger((md), (action), (call))
+
+/* stat_block • counts a block parser, passing on what it consumed */
+static inline size_t
+stat_block(struct sd_markdown *md, enum mkd_stat_block kind, size_t used)
+{
+	if (md->stats) {
+		md->stats->block_calls[kind]++;
+		md->stats->block_bytes[kind] += used;
+		if (!used)
+			md->stats->block_misses[kind]++;
+	}
+
+	return used;
+}
+
+/* stat_trigger • counts the handler of an active char, markdown_char_t */
+static inline size_t
+stat_trigger(struct sd_markdown *md, int action, size_t used)
+{
+	if (md->stats) {
+		md->stats->trigger_calls[action - 1]++;
+		md->stats->trigger_bytes[action - 1] += used;
+		if (!used)
+			md->stats->trigger_misses[action - 1]++;
+	}
+
+	return used;
+}
+
+/* stat_clock • monotonic seconds */
+static double
+stat_clock(void)
+{
+#ifdef _WIN32
+	LARGE_INTEGER count, freq;
+	QueryPerformanceCounter(&count);
+	QueryPerformanceFrequency(&freq);
+	return (double)count.QuadPart / freq.QuadPart;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+#endif
+}
+
+#else
+
+#define STAT(md, field, n) do { } while (0)
+#define STAT_BLOCK(md, kind, call) (call)
+#define STAT_TRIGGER(md, action, call) (call)
+
+#endif
+
 /***************************
  * HELPER FUNCTIONS *
  ***************************/
 
+static void *
+mem_realloc(void *opaque, void *ptr, size_t old_size, size_t new_size)
+{
+	struct mem_tracker *tracker = opaque;
+	struct sd_markdown *md = tracker->md;
+	void *neoptr;
+
+	if (new_size > old_size) {
+		/* without a budget, every buffer keeps the historical ceiling */
+		if (md->mem_limit ?
+			md->mem_used - old_size + new_size > md->mem_limit :
+			new_size > BUFFER_MAX_ALLOC_SIZE) {
+			md->status = MKD_EBUDGET;
+			return NULL;
+		}
+	}
+
+	if (tracker->parent)
+		neoptr = tracker->parent->realloc(tracker->parent->opaque, ptr, old_size, new_size);
+	else
+		neoptr = realloc(ptr, new_size);
+
+	if (!neoptr) {
+		md->status = MKD_ENOMEM;
+		return NULL;
+	}
+
+	if (ptr) {
+		STAT(md, reallocs, 1);
+		STAT(md, realloc_bytes, new_size);
+	}
+	else
+		STAT(md, allocs, 1);
+
+	md->mem_used = md->mem_used - old_size + new_size;
+	if (md->mem_used > md->mem_peak)
+		md->mem_peak = md->mem_used;
+
+	return neoptr;
+}
+
+static void
+mem_free(void *opaque, void *ptr, size_t size)
+{
+	struct mem_tracker *tracker = opaque;
+
+	bufmem_free(tracker->parent, ptr, size);
+	tracker->md->mem_used -= size;
+}
+
+static void
+mem_tracker_init(struct mem_tracker *tracker, struct sd_markdown *md,
+	const struct buf_allocator *parent)
+{
+	tracker->hooks.realloc = mem_realloc;
+	tracker->hooks.free = mem_free;
+	tracker->hooks.opaque = tracker;
+	tracker->parent = parent;
+	tracker->md = md;
+}
+
 static inline struct buf *
 rndr_newbuf(struct sd_markdown *rndr, int type)
 {
@@ -133,11 +382,28 @@ rndr_newbuf(struct sd_markdown *rndr, int type)
 		pool->item[pool->size] != NULL) {
 		work = pool->item[pool->size++];
 		work->size = 0;
+		STAT(rndr, bufs_reused, 1);
 	} else {
-		work = bufnew(buf_size[type]);
+		work = bufnew_with(buf_size[type], rndr->alloc);
+		STAT(rndr, bufs_new, 1);
+
+		/* over budget: keep the parser going on an untracked buffer,
+		 * the render has already failed anyway */
+		if (!work)
+			work = bufnew(buf_size[type]);
+
+		if (work)
+			work->growth = BUF_GROW_CAPPED;
 		stack_push(pool, work);
 	}
 
+#ifdef SUNDOWN_STATS
+	if (rndr->stats && rndr->stats->max_depth <
+		rndr->work_bufs[BUFFER_SPAN].size + rndr->work_bufs[BUFFER_BLOCK].size)
+		rndr->stats->max_depth =
+			rndr->work_bufs[BUFFER_SPAN].size + rndr->work_bufs[BUFFER_BLOCK].size;
+#endif
+
 	return work;
 }
 
@@ -147,6 +413,77 @@ rndr_popbuf(struct sd_markdown *rndr, int type)
 	rndr->work_bufs[type].size--;
 }
 
+/* node_init • a node of the given type, nothing else set */
+static inline void
+node_init(struct sd_node *node, enum mkd_node type)
+{
+	memset(node, 0x0, sizeof(struct sd_node));
+	node->type = type;
+}
+
+/* node_enter • emits the enter event of a node, 0 if it was dropped */
+/*	the parsers keep pushing their working buffers in event mode, so
+ *	that the nesting limit is reached at the same depth */
+static int
+node_enter(struct buf *ob, struct sd_markdown *rndr, struct sd_node *node)
+{
+	node->base = rndr->node_base;
+	node->offset = ob->size;
+
+	if (!rndr->cfg->events.enter(ob, node, rndr->opaque)) {
+		ob->size = node->offset;
+		return 0;
+	}
+
+	node->content = ob->size;
+	rndr->node_base = node->content;
+	return 1;
+}
+
+/* node_leave • emits the leave event of an entered node */
+static int
+node_leave(struct buf *ob, struct sd_markdown *rndr, struct sd_node *node)
+{
+	rndr->node_base = node->base;
+
+	if (!rndr->cfg->events.leave(ob, node, rndr->opaque)) {
+		ob->size = node->offset;
+		return 0;
+	}
+
+	return 1;
+}
+
+/* node_leaf • emits a node without children */
+static int
+node_leaf(struct buf *ob, struct sd_markdown *rndr, struct sd_node *node)
+{
+	node->base = rndr->node_base;
+	node->offset = node->content = ob->size;
+
+	/* what the consumer cut from before the node stays cut */
+	if (!rndr->cfg->events.enter(ob, node, rndr->opaque)) {
+		if (ob->size > node->offset)
+			ob->size = node->offset;
+		return 0;
+	}
+
+	return 1;
+}
+
+/* node_text • emits a leaf over a piece of the text */
+static int
+node_text(struct buf *ob, struct sd_markdown *rndr, enum mkd_node type,
+	const uint8_t *data, size_t size)
+{
+	struct buf text = { (uint8_t *)data, size, 0, 0 };
+	struct sd_node node;
+
+	node_init(&node, type);
+	node.text = &text;
+	return node_leaf(ob, rndr, &node);
+}
+
 static void
 unscape_text(struct buf *ob, struct buf *src)
 {
@@ -182,57 +519,158 @@ hash_link_ref(const uint8_t *link_ref, size_t length)
 static struct link_ref *
 add_link_ref(
 	struct link_ref **references,
+	const struct buf_allocator *alloc,
 	const uint8_t *name, size_t name_size)
 {
-	struct link_ref *ref = calloc(1, sizeof(struct link_ref));
+	struct link_ref *ref = bufmem_alloc(alloc, sizeof(struct link_ref) + name_size);
 
 	if (!ref)
 		return NULL;
 
+	memset(ref, 0x0, sizeof(struct link_ref));
+
 	ref->id = hash_link_ref(name, name_size);
-	ref->next = references[ref->id % REF_TABLE_SIZE];
+	ref->name = (uint8_t *)(ref + 1);
+	ref->name_size = name_size;
+	memcpy(ref->name, name, name_size);
 
-	references[ref->id % REF_TABLE_SIZE] = ref;
+	ref->next = *references;
+	*references = ref;
 	return ref;
 }
 
+/* link_ref_eq • case-insensitive comparison of a reference name */
+static int
+link_ref_eq(const struct link_ref *ref, unsigned int hash, const uint8_t *name, size_t length)
+{
+	size_t i;
+
+	if (ref->id != hash || ref->name_size != length)
+		return 0;
+
+	for (i = 0; i < length; ++i)
+		if (tolower(ref->name[i]) != tolower(name[i]))
+			return 0;
+
+	return 1;
+}
+
+/* index_link_refs • builds the lookup table once all references are known */
+/*	a name defined twice resolves to its latest definition */
+static int
+index_link_refs(struct sd_markdown *md)
+{
+	struct link_ref *ref;
+	size_t count = 0, mask, i;
+
+	/* most small documents have no reference at all */
+	if (!md->ref_list)
+		return 0;
+
+	for (ref = md->ref_list; ref; ref = ref->next)
+		count++;
+
+	/* keeping the load factor at or under one half */
+	md->refs_size = REF_TABLE_MIN;
+	while (md->refs_size < count * 2)
+		md->refs_size *= 2;
+
+	md->refs = bufmem_alloc(md->alloc, md->refs_size * sizeof(struct link_ref *));
+	if (!md->refs) {
+		md->refs_size = 0;
+		return -1;
+	}
+
+	memset(md->refs, 0x0, md->refs_size * sizeof(struct link_ref *));
+	mask = md->refs_size - 1;
+
+	for (ref = md->ref_list; ref; ref = ref->next) {
+		for (i = ref->id & mask; md->refs[i]; i = (i + 1) & mask)
+			if (link_ref_eq(md->refs[i], ref->id, ref->name, ref->name_size))
+				break;
+
+		if (!md->refs[i])
+			md->refs[i] = ref;
+	}
+
+	return 0;
+}
+
 static struct link_ref *
-find_link_ref(struct link_ref **references, uint8_t *name, size_t length)
+lookup_link_ref(struct sd_markdown *md, const uint8_t *name, size_t length)
 {
 	unsigned int hash = hash_link_ref(name, length);
-	struct link_ref *ref = NULL;
+	size_t i, mask = md->refs_size - 1;
 
-	ref = references[hash % REF_TABLE_SIZE];
+	if (!md->refs_size)
+		return NULL;
+
+	for (i = hash & mask; md->refs[i]; i = (i + 1) & mask)
+		if (link_ref_eq(md->refs[i], hash, name, length))
+			return md->refs[i];
+
+	return NULL;
+}
+
+/* ref_hash • what a reference lookup gave, 0 for nothing */
+static uint64_t
+ref_hash(const struct link_ref *ref)
+{
+	uint64_t h;
+
+	if (!ref)
+		return 0;
 
-	while (ref != NULL) {
-		if (ref->id == hash)
-			return ref;
+	h = ref->link ? bufhash(ref->link->data, ref->link->size, 1) : 1;
+	if (ref->title)
+		h = bufhash(ref->title->data, ref->title->size, h);
+
+	return h | 1;
+}
 
-		ref = ref->next;
+/* find_link_ref • reference lookup from the parsers */
+/*	blocks bound for the cache note the lookups they depend on */
+static struct link_ref *
+find_link_ref(struct sd_markdown *md, uint8_t *name, size_t length)
+{
+	struct link_ref *ref = lookup_link_ref(md, name, length);
+	struct block_ref noted;
+
+	if (md->cache_block) {
+		noted.name_size = length;
+		noted.hash = ref_hash(ref);
+		bufput(md->cache_refs, &noted, sizeof(noted));
+		bufput(md->cache_refs, name, length);
 	}
 
-	return NULL;
+	return ref;
 }
 
 static void
-free_link_refs(struct link_ref **references)
+free_ref_list(struct sd_markdown *md, struct link_ref *r)
 {
-	size_t i;
-
-	for (i = 0; i < REF_TABLE_SIZE; ++i) {
-		struct link_ref *r = references[i];
-		struct link_ref *next;
+	struct link_ref *next;
 
-		while (r) {
-			next = r->next;
-			bufrelease(r->link);
-			bufrelease(r->title);
-			free(r);
-			r = next;
-		}
+	while (r) {
+		next = r->next;
+		bufrelease(r->link);
+		bufrelease(r->title);
+		bufmem_free(md->alloc, r, sizeof(struct link_ref) + r->name_size);
+		r = next;
 	}
 }
 
+static void
+free_link_refs(struct sd_markdown *md)
+{
+	free_ref_list(md, md->ref_list);
+
+	bufmem_free(md->alloc, md->refs, md->refs_size * sizeof(struct link_ref *));
+	md->ref_list = NULL;
+	md->refs = NULL;
+	md->refs_size = 0;
+}
+
 /*
  * Check whether a char is a Markdown space.
 
@@ -348,6 +786,71 @@ tag_length(uint8_t *data, size_t size, enum mkd_autolink *autolink)
 	return i + 1;
 }
 
+/* find_active_char • skips the inactive chars, returning the next trigger */
+/*	or size; vector paths test a whole block of chars per step */
+static inline size_t
+find_active_char(struct sd_markdown *rndr, const uint8_t *data, size_t i, size_t size)
+{
+#if defined(SD_SIMD_AVX2)
+	const __m256i lo_tbl = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)rndr->cfg->active_lo));
+	const __m256i hi_tbl = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)rndr->cfg->active_hi));
+	const __m256i nibble = _mm256_set1_epi8(0x0f);
+
+	while (i + 32 <= size) {
+		__m256i block = _mm256_loadu_si256((const __m256i *)(data + i));
+		__m256i lo = _mm256_shuffle_epi8(lo_tbl, _mm256_and_si256(block, nibble));
+		__m256i hi = _mm256_shuffle_epi8(hi_tbl, _mm256_and_si256(_mm256_srli_epi16(block, 4), nibble));
+		unsigned int mask = ~(unsigned int)_mm256_movemask_epi8(
+			_mm256_cmpeq_epi8(_mm256_and_si256(lo, hi), _mm256_setzero_si256()));
+
+		if (mask)
+			return i + sd_ctz(mask);
+		i += 32;
+	}
+#elif defined(SD_SIMD_SSSE3)
+	const __m128i lo_tbl = _mm_loadu_si128((const __m128i *)rndr->cfg->active_lo);
+	const __m128i hi_tbl = _mm_loadu_si128((const __m128i *)rndr->cfg->active_hi);
+	const __m128i nibble = _mm_set1_epi8(0x0f);
+
+	while (i + 16 <= size) {
+		__m128i block = _mm_loadu_si128((const __m128i *)(data + i));
+		__m128i lo = _mm_shuffle_epi8(lo_tbl, _mm_and_si128(block, nibble));
+		__m128i hi = _mm_shuffle_epi8(hi_tbl, _mm_and_si128(_mm_srli_epi16(block, 4), nibble));
+		unsigned int mask = 0xffff & ~(unsigned int)_mm_movemask_epi8(
+			_mm_cmpeq_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128()));
+
+		if (mask)
+			return i + sd_ctz(mask);
+		i += 16;
+	}
+#elif defined(SD_SIMD_SSE2)
+	__m128i active[16];
+	size_t c, count = rndr->cfg->active_count;
+
+	for (c = 0; c < count; ++c)
+		active[c] = _mm_set1_epi8((char)rndr->cfg->active_list[c]);
+
+	while (i + 16 <= size) {
+		__m128i block = _mm_loadu_si128((const __m128i *)(data + i));
+		__m128i hits = _mm_cmpeq_epi8(block, active[0]);
+		unsigned int mask;
+
+		for (c = 1; c < count; ++c)
+			hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, active[c]));
+
+		mask = (unsigned int)_mm_movemask_epi8(hits);
+		if (mask)
+			return i + sd_ctz(mask);
+		i += 16;
+	}
+#endif
+
+	while (i < size && rndr->cfg->active_char[data[i]] == 0)
+		i++;
+
+	return i;
+}
+
 /* parse_inline • parses inline markdown elements */
 static void
 parse_inline(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t size)
@@ -355,29 +858,40 @@ parse_inline(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t siz
 	size_t i = 0, end = 0;
 	uint8_t action = 0;
 	struct buf work = { 0, 0, 0, 0 };
+	struct emph_span span = { data, size, NULL }, *parent_span;
 
 	if (rndr->work_bufs[BUFFER_SPAN].size +
-		rndr->work_bufs[BUFFER_BLOCK].size > rndr->max_nesting)
+		rndr->work_bufs[BUFFER_BLOCK].size > rndr->cfg->max_nesting ||
+		rndr->status)
 		return;
 
+	parent_span = rndr->emph_span;
+	rndr->emph_span = &span;
+
 	while (i < size) {
 		/* copying inactive chars into the output */
-		while (end < size && (action = rndr->active_char[data[end]]) == 0) {
-			end++;
-		}
+		end = find_active_char(rndr, data, end, size);
+		if (end < size)
+			action = rndr->cfg->active_char[data[end]];
 
-		if (rndr->cb.normal_text) {
+		if (rndr->cfg->events.enter) {
+			if (end > i)
+				node_text(ob, rndr, MKDN_TEXT, data + i, end - i);
+		}
+		else if (rndr->cfg->cb.normal_text) {
 			work.data = data + i;
 			work.size = end - i;
-			rndr->cb.normal_text(ob, &work, rndr->opaque);
+			rndr->cfg->cb.normal_text(ob, &work, rndr->opaque);
 		}
 		else
 			bufput(ob, data + i, end - i);
 
-		if (end >= size) break;
+		/* triggers may rewind ob, which is unsafe once a write failed */
+		if (end >= size || rndr->status) break;
 		i = end;
 
-		end = markdown_char_ptrs[(int)action](ob, rndr, data + i, i, size - i);
+		end = STAT_TRIGGER(rndr, action,
+			markdown_char_ptrs[(int)action](ob, rndr, data + i, i, size - i));
 		if (!end) /* no action from the callback */
 			end = i + 1;
 		else {
@@ -385,6 +899,9 @@ parse_inline(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t siz
 			end = i;
 		}
 	}
+
+	rndr->emph_span = parent_span;
+	bufmem_free(rndr->alloc, span.failed, size);
 }
 
 /* find_emph_char • looks for the next emph uint8_t, skipping other constructs */
@@ -478,42 +995,120 @@ find_emph_char(uint8_t *data, size_t size, uint8_t c)
 	return 0;
 }
 
+/* emph_closes • whether the emph char at data[i] closes an emphasis */
+/*	of the given kind (1, 2 or 3 symbols) */
+static int
+emph_closes(struct sd_markdown *rndr, uint8_t *data, size_t size, size_t i, uint8_t c, int kind)
+{
+	if (data[i] != c || _isspace(data[i - 1]))
+		return 0;
+
+	if (kind == 1)
+		return !((rndr->cfg->ext_flags & MKDEXT_NO_INTRA_EMPHASIS) &&
+			i + 1 < size && isalnum(data[i + 1]));
+
+	if (kind == 2)
+		return i + 1 < size && data[i + 1] == c;
+
+	return 1;
+}
+
+/* find_emph_closer • walks the emph chars from data[i] to the first closer */
+/*	a walk only depends on the emph char it has reached, so once a walk
+ *	fails, every emph char it went through is marked in the current span;
+ *	later walks stop there, keeping runs of unmatched symbols linear */
+static size_t
+find_emph_closer(struct sd_markdown *rndr, uint8_t *data, size_t size, size_t i, uint8_t c, int kind)
+{
+	struct emph_span *span = rndr->emph_span;
+	size_t len, start = i, pos;
+	int mark = 0;
+
+	for (;;) {
+		while (i < size) {
+			len = find_emph_char(data + i, size - i, c);
+			if (!len)
+				break;
+
+			i += len;
+			pos = (data + i) - span->data;
+
+			if (span->failed && (span->failed[pos] & (1 << kind)))
+				break;
+
+			if (mark)
+				span->failed[pos] |= 1 << kind;
+			else if (emph_closes(rndr, data, size, i, c, kind))
+				return i;
+
+			/* double emphasis resumes past the closer it tried */
+			if (kind == 2)
+				i++;
+		}
+
+		if (mark)
+			return 0;
+
+		if (!span->failed) {
+			span->failed = bufmem_alloc(rndr->alloc, span->size);
+			if (!span->failed)
+				return 0;
+
+			memset(span->failed, 0x0, span->size);
+		}
+
+		/* walking the same path again to mark it */
+		mark = 1;
+		i = start;
+	}
+}
+
+/* span_node • emits a span node around the inline parse of data, which
+ * lead and trail bytes of markup enclose */
+static int
+span_node(struct buf *ob, struct sd_markdown *rndr, enum mkd_node type, uint8_t *data, size_t size,
+	size_t lead, size_t trail)
+{
+	struct sd_node node;
+
+	node_init(&node, type);
+	node.source = data - lead;
+	node.source_size = lead + size + trail;
+	node.lead = lead;
+	node.trail = trail;
+	if (!node_enter(ob, rndr, &node))
+		return 0;
+
+	parse_inline(ob, rndr, data, size);
+	return node_leave(ob, rndr, &node);
+}
+
 /* parse_emph1 • parsing single emphase */
 /* closed by a symbol not preceded by whitespace and not followed by symbol */
 static size_t
 parse_emph1(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t size, uint8_t c)
 {
-	size_t i = 0, len;
+	size_t i = 0;
 	struct buf *work = 0;
 	int r;
 
-	if (!rndr->cb.emphasis) return 0;
+	if (!rndr->cfg->cb.emphasis) return 0;
 
 	/* skipping one symbol if coming from emph3 */
 	if (size > 1 && data[0] == c && data[1] == c) i = 1;
 
-	while (i < size) {
-		len = find_emph_char(data + i, size - i, c);
-		if (!len) return 0;
-		i += len;
-		if (i >= size) return 0;
-
-		if (data[i] == c && !_isspace(data[i - 1])) {
-
-			if (rndr->ext_flags & MKDEXT_NO_INTRA_EMPHASIS) {
-				if (i + 1 < size && isalnum(data[i + 1]))
-					continue;
-			}
+	i = find_emph_closer(rndr, data, size, i, c, 1);
+	if (!i) return 0;
 
-			work = rndr_newbuf(rndr, BUFFER_SPAN);
-			parse_inline(work, rndr, data, i);
-			r = rndr->cb.emphasis(ob, work, rndr->opaque);
-			rndr_popbuf(rndr, BUFFER_SPAN);
-			return r ? i + 1 : 0;
-		}
+	work = rndr_newbuf(rndr, BUFFER_SPAN);
+	if (rndr->cfg->events.enter)
+		r = span_node(ob, rndr, MKDN_EMPHASIS, data, i, 1, 1);
+	else {
+		parse_inline(work, rndr, data, i);
+		r = rndr->cfg->cb.emphasis(ob, work, rndr->opaque);
 	}
-
-	return 0;
+	rndr_popbuf(rndr, BUFFER_SPAN);
+	return r ? i + 1 : 0;
 }
 
 /* parse_emph2 • parsing single emphase */
@@ -521,30 +1116,27 @@ static size_t
 parse_emph2(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t size, uint8_t c)
 {
 	int (*render_method)(struct buf *ob, const struct buf *text, void *opaque);
-	size_t i = 0, len;
+	size_t i;
 	struct buf *work = 0;
 	int r;
 
-	render_method = (c == '~') ? rndr->cb.strikethrough : rndr->cb.double_emphasis;
+	render_method = (c == '~') ? rndr->cfg->cb.strikethrough : rndr->cfg->cb.double_emphasis;
 
 	if (!render_method)
 		return 0;
 
-	while (i < size) {
-		len = find_emph_char(data + i, size - i, c);
-		if (!len) return 0;
-		i += len;
+	i = find_emph_closer(rndr, data, size, 0, c, 2);
+	if (!i) return 0;
 
-		if (i + 1 < size && data[i] == c && data[i + 1] == c && i && !_isspace(data[i - 1])) {
-			work = rndr_newbuf(rndr, BUFFER_SPAN);
-			parse_inline(work, rndr, data, i);
-			r = render_method(ob, work, rndr->opaque);
-			rndr_popbuf(rndr, BUFFER_SPAN);
-			return r ? i + 2 : 0;
-		}
-		i++;
+	work = rndr_newbuf(rndr, BUFFER_SPAN);
+	if (rndr->cfg->events.enter)
+		r = span_node(ob, rndr, c == '~' ? MKDN_STRIKETHROUGH : MKDN_DOUBLE_EMPHASIS, data, i, 2, 2);
+	else {
+		parse_inline(work, rndr, data, i);
+		r = render_method(ob, work, rndr->opaque);
 	}
-	return 0;
+	rndr_popbuf(rndr, BUFFER_SPAN);
+	return r ? i + 2 : 0;
 }
 
 /* parse_emph3 • parsing single emphase */
@@ -552,41 +1144,37 @@ parse_emph2(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t size
 static size_t
 parse_emph3(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t size, uint8_t c)
 {
-	size_t i = 0, len;
+	size_t i, len;
 	int r;
 
-	while (i < size) {
-		len = find_emph_char(data + i, size - i, c);
-		if (!len) return 0;
-		i += len;
+	i = find_emph_closer(rndr, data, size, 0, c, 3);
+	if (!i) return 0;
 
-		/* skip whitespace preceded symbols */
-		if (data[i] != c || _isspace(data[i - 1]))
-			continue;
-
-		if (i + 2 < size && data[i + 1] == c && data[i + 2] == c && rndr->cb.triple_emphasis) {
-			/* triple symbol found */
-			struct buf *work = rndr_newbuf(rndr, BUFFER_SPAN);
+	if (i + 2 < size && data[i + 1] == c && data[i + 2] == c && rndr->cfg->cb.triple_emphasis) {
+		/* triple symbol found */
+		struct buf *work = rndr_newbuf(rndr, BUFFER_SPAN);
 
+		if (rndr->cfg->events.enter)
+			r = span_node(ob, rndr, MKDN_TRIPLE_EMPHASIS, data, i, 3, 3);
+		else {
 			parse_inline(work, rndr, data, i);
-			r = rndr->cb.triple_emphasis(ob, work, rndr->opaque);
-			rndr_popbuf(rndr, BUFFER_SPAN);
-			return r ? i + 3 : 0;
+			r = rndr->cfg->cb.triple_emphasis(ob, work, rndr->opaque);
+		}
+		rndr_popbuf(rndr, BUFFER_SPAN);
+		return r ? i + 3 : 0;
 
-		} else if (i + 1 < size && data[i + 1] == c) {
-			/* double symbol found, handing over to emph1 */
-			len = parse_emph1(ob, rndr, data - 2, size + 2, c);
-			if (!len) return 0;
-			else return len - 2;
+	} else if (i + 1 < size && data[i + 1] == c) {
+		/* double symbol found, handing over to emph1 */
+		len = parse_emph1(ob, rndr, data - 2, size + 2, c);
+		if (!len) return 0;
+		else return len - 2;
 
-		} else {
-			/* single symbol found, handing over to emph2 */
-			len = parse_emph2(ob, rndr, data - 1, size + 1, c);
-			if (!len) return 0;
-			else return len - 1;
-		}
+	} else {
+		/* single symbol found, handing over to emph2 */
+		len = parse_emph2(ob, rndr, data - 1, size + 1, c);
+		if (!len) return 0;
+		else return len - 1;
 	}
-	return 0;
 }
 
 /* char_emphasis • single and double emphasis parsing */
@@ -596,7 +1184,7 @@ char_emphasis(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t of
 	uint8_t c = data[0];
 	size_t ret;
 
-	if (rndr->ext_flags & MKDEXT_NO_INTRA_EMPHASIS) {
+	if (rndr->cfg->ext_flags & MKDEXT_NO_INTRA_EMPHASIS) {
 		if (offset > 0 && !_isspace(data[-1]) && data[-1] != '>')
 			return 0;
 	}
@@ -635,11 +1223,18 @@ char_linebreak(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t o
 	if (offset < 2 || data[-1] != ' ' || data[-2] != ' ')
 		return 0;
 
+	if (rndr->cfg->events.enter) {
+		struct sd_node node;
+
+		node_init(&node, MKDN_LINEBREAK);
+		return node_leaf(ob, rndr, &node) ? 1 : 0;
+	}
+
 	/* removing the last space from ob and rendering */
 	while (ob->size && ob->data[ob->size - 1] == ' ')
 		ob->size--;
 
-	return rndr->cb.linebreak(ob, rndr->opaque) ? 1 : 0;
+	return rndr->cfg->cb.linebreak(ob, rndr->opaque) ? 1 : 0;
 }
 
 
@@ -672,13 +1267,24 @@ char_codespan(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t of
 	while (f_end > nb && data[f_end-1] == ' ')
 		f_end--;
 
+	if (rndr->cfg->events.enter) {
+		struct buf work = { data + f_begin, f_begin < f_end ? f_end - f_begin : 0, 0, 0 };
+		struct sd_node node;
+
+		node_init(&node, MKDN_CODESPAN);
+		node.text = f_begin < f_end ? &work : NULL;
+		node.source = data;
+		node.source_size = end;
+		return node_leaf(ob, rndr, &node) ? end : 0;
+	}
+
 	/* real code span */
 	if (f_begin < f_end) {
 		struct buf work = { data + f_begin, f_end - f_begin, 0, 0 };
-		if (!rndr->cb.codespan(ob, &work, rndr->opaque))
+		if (!rndr->cfg->cb.codespan(ob, &work, rndr->opaque))
 			end = 0;
 	} else {
-		if (!rndr->cb.codespan(ob, 0, rndr->opaque))
+		if (!rndr->cfg->cb.codespan(ob, 0, rndr->opaque))
 			end = 0;
 	}
 
@@ -697,14 +1303,19 @@ char_escape(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t offs
 		if (strchr(escape_chars, data[1]) == NULL)
 			return 0;
 
-		if (rndr->cb.normal_text) {
+		if (rndr->cfg->events.enter)
+			node_text(ob, rndr, MKDN_TEXT, data + 1, 1);
+		else if (rndr->cfg->cb.normal_text) {
 			work.data = data + 1;
 			work.size = 1;
-			rndr->cb.normal_text(ob, &work, rndr->opaque);
+			rndr->cfg->cb.normal_text(ob, &work, rndr->opaque);
 		}
 		else bufputc(ob, data[1]);
 	} else if (size == 1) {
-		bufputc(ob, data[0]);
+		if (rndr->cfg->events.enter)
+			node_text(ob, rndr, MKDN_TEXT, data, 1);
+		else
+			bufputc(ob, data[0]);
 	}
 
 	return 2;
@@ -729,16 +1340,41 @@ char_entity(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t offs
 	else
 		return 0; /* lone '&' */
 
-	if (rndr->cb.entity) {
+	if (rndr->cfg->events.enter)
+		node_text(ob, rndr, MKDN_ENTITY, data, end);
+	else if (rndr->cfg->cb.entity) {
 		work.data = data;
 		work.size = end;
-		rndr->cb.entity(ob, &work, rndr->opaque);
+		rndr->cfg->cb.entity(ob, &work, rndr->opaque);
 	}
 	else bufput(ob, data, end);
 
 	return end;
 }
 
+/* autolink_render • hands an autolink to its callback or its event;
+ * rewind bytes of the text before it are part of the link, which was
+ * written as the size bytes at source */
+static int
+autolink_render(struct buf *ob, struct sd_markdown *rndr, const struct buf *link,
+	enum mkd_autolink type, size_t rewind, const uint8_t *source, size_t size)
+{
+	struct sd_node node;
+
+	if (!rndr->cfg->events.enter) {
+		ob->size -= rewind;
+		return rndr->cfg->cb.autolink(ob, link, type, rndr->opaque);
+	}
+
+	node_init(&node, MKDN_AUTOLINK);
+	node.link = link;
+	node.autolink = type;
+	node.rewind = rewind;
+	node.source = source;
+	node.source_size = size;
+	return node_leaf(ob, rndr, &node);
+}
+
 /* char_langle_tag • '<' when tags or autolinks are allowed */
 static size_t
 char_langle_tag(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t offset, size_t size)
@@ -749,16 +1385,18 @@ char_langle_tag(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t
 	int ret = 0;
 
 	if (end > 2) {
-		if (rndr->cb.autolink && altype != MKDA_NOT_AUTOLINK) {
+		if (rndr->cfg->cb.autolink && altype != MKDA_NOT_AUTOLINK) {
 			struct buf *u_link = rndr_newbuf(rndr, BUFFER_SPAN);
 			work.data = data + 1;
 			work.size = end - 2;
 			unscape_text(u_link, &work);
-			ret = rndr->cb.autolink(ob, u_link, altype, rndr->opaque);
+			ret = autolink_render(ob, rndr, u_link, altype, 0, data, end);
 			rndr_popbuf(rndr, BUFFER_SPAN);
 		}
-		else if (rndr->cb.raw_html_tag)
-			ret = rndr->cb.raw_html_tag(ob, &work, rndr->opaque);
+		else if (rndr->cfg->events.enter)
+			ret = node_text(ob, rndr, MKDN_RAW_HTML, data, end);
+		else if (rndr->cfg->cb.raw_html_tag)
+			ret = rndr->cfg->cb.raw_html_tag(ob, &work, rndr->opaque);
 	}
 
 	if (!ret) return 0;
@@ -771,7 +1409,7 @@ char_autolink_www(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_
 	struct buf *link, *link_url, *link_text;
 	size_t link_len, rewind;
 
-	if (!rndr->cb.link || rndr->in_link_body)
+	if (!rndr->cfg->cb.link || rndr->in_link_body)
 		return 0;
 
 	link = rndr_newbuf(rndr, BUFFER_SPAN);
@@ -782,13 +1420,24 @@ char_autolink_www(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_
 		bufput(link_url, link->data, link->size);
 
 		ob->size -= rewind;
-		if (rndr->cb.normal_text) {
+		if (rndr->cfg->events.enter) {
+			struct sd_node node;
+
+			node_init(&node, MKDN_LINK);
+			node.link = link_url;
+			node.source = data;
+			node.source_size = link_len;
+			if (node_enter(ob, rndr, &node)) {
+				node_text(ob, rndr, MKDN_TEXT, link->data, link->size);
+				node_leave(ob, rndr, &node);
+			}
+		} else if (rndr->cfg->cb.normal_text) {
 			link_text = rndr_newbuf(rndr, BUFFER_SPAN);
-			rndr->cb.normal_text(link_text, link, rndr->opaque);
-			rndr->cb.link(ob, link_url, NULL, link_text, rndr->opaque);
+			rndr->cfg->cb.normal_text(link_text, link, rndr->opaque);
+			rndr->cfg->cb.link(ob, link_url, NULL, link_text, rndr->opaque);
 			rndr_popbuf(rndr, BUFFER_SPAN);
 		} else {
-			rndr->cb.link(ob, link_url, NULL, link, rndr->opaque);
+			rndr->cfg->cb.link(ob, link_url, NULL, link, rndr->opaque);
 		}
 		rndr_popbuf(rndr, BUFFER_SPAN);
 	}
@@ -803,15 +1452,13 @@ char_autolink_email(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, siz
 	struct buf *link;
 	size_t link_len, rewind;
 
-	if (!rndr->cb.autolink || rndr->in_link_body)
+	if (!rndr->cfg->cb.autolink || rndr->in_link_body)
 		return 0;
 
 	link = rndr_newbuf(rndr, BUFFER_SPAN);
 
-	if ((link_len = sd_autolink__email(&rewind, link, data, offset, size, 0)) > 0) {
-		ob->size -= rewind;
-		rndr->cb.autolink(ob, link, MKDA_EMAIL, rndr->opaque);
-	}
+	if ((link_len = sd_autolink__email(&rewind, link, data, offset, size, 0)) > 0)
+		autolink_render(ob, rndr, link, MKDA_EMAIL, rewind, data - rewind, rewind + link_len);
 
 	rndr_popbuf(rndr, BUFFER_SPAN);
 	return link_len;
@@ -823,20 +1470,62 @@ char_autolink_url(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_
 	struct buf *link;
 	size_t link_len, rewind;
 
-	if (!rndr->cb.autolink || rndr->in_link_body)
+	if (!rndr->cfg->cb.autolink || rndr->in_link_body)
 		return 0;
 
 	link = rndr_newbuf(rndr, BUFFER_SPAN);
 
-	if ((link_len = sd_autolink__url(&rewind, link, data, offset, size, 0)) > 0) {
-		ob->size -= rewind;
-		rndr->cb.autolink(ob, link, MKDA_NORMAL, rndr->opaque);
-	}
+	if ((link_len = sd_autolink__url(&rewind, link, data, offset, size, 0)) > 0)
+		autolink_render(ob, rndr, link, MKDA_NORMAL, rewind, data - rewind, rewind + link_len);
 
 	rndr_popbuf(rndr, BUFFER_SPAN);
 	return link_len;
 }
 
+/* link_events • the events of a link or an image whose text ends at txt_e,
+ * and the whole of it at end */
+static int
+link_events(struct buf *ob, struct sd_markdown *rndr, int is_img, uint8_t *data,
+	size_t txt_e, size_t end, struct buf *link, const struct buf *title)
+{
+	struct buf alt = { data + 1, txt_e - 1, 0, 0 };
+	struct sd_node node;
+
+	node_init(&node, is_img ? MKDN_IMAGE : MKDN_LINK);
+	node.title = title;
+	node.source = data;
+	node.source_size = end;
+	node.lead = 1;
+	node.trail = end - txt_e;
+
+	/* a callback render parses the link text one buffer deeper */
+	if (link || (txt_e > 1 && !is_img)) {
+		struct buf *u_link = rndr_newbuf(rndr, BUFFER_SPAN);
+		if (link) {
+			unscape_text(u_link, link);
+			node.link = u_link;
+		}
+	}
+
+	if (is_img) {
+		node.text = txt_e > 1 ? &alt : NULL;
+		return node_leaf(ob, rndr, &node);
+	}
+
+	if (!node_enter(ob, rndr, &node))
+		return 0;
+
+	/* disable autolinking when parsing inline the
+	 * content of a link */
+	if (txt_e > 1) {
+		rndr->in_link_body = 1;
+		parse_inline(ob, rndr, data + 1, txt_e - 1);
+		rndr->in_link_body = 0;
+	}
+
+	return node_leave(ob, rndr, &node);
+}
+
 /* char_link • '[': parsing a link or an image */
 static size_t
 char_link(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t offset, size_t size)
@@ -852,7 +1541,7 @@ char_link(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t offset
 	int in_title = 0, qtype = 0;
 
 	/* checking whether the correct renderer exists */
-	if ((is_img && !rndr->cb.image) || (!is_img && !rndr->cb.link))
+	if ((is_img && !rndr->cfg->cb.image) || (!is_img && !rndr->cfg->cb.link))
 		goto cleanup;
 
 	/* looking for the matching closing bracket */
@@ -991,7 +1680,7 @@ char_link(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t offset
 			id.size = link_e - link_b;
 		}
 
-		lr = find_link_ref(rndr->refs, id.data, id.size);
+		lr = find_link_ref(rndr, id.data, id.size);
 		if (!lr)
 			goto cleanup;
 
@@ -1026,7 +1715,7 @@ char_link(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t offset
 		}
 
 		/* finding the link_ref */
-		lr = find_link_ref(rndr->refs, id.data, id.size);
+		lr = find_link_ref(rndr, id.data, id.size);
 		if (!lr)
 			goto cleanup;
 
@@ -1038,6 +1727,11 @@ char_link(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t offset
 		i = txt_e + 1;
 	}
 
+	if (rndr->cfg->events.enter) {
+		ret = link_events(ob, rndr, is_img, data, txt_e, i, link, title);
+		goto cleanup;
+	}
+
 	/* building content: img alt is escaped, link content is parsed */
 	if (txt_e > 1) {
 		content = rndr_newbuf(rndr, BUFFER_SPAN);
@@ -1062,9 +1756,9 @@ char_link(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t offset
 		if (ob->size && ob->data[ob->size - 1] == '!')
 			ob->size -= 1;
 
-		ret = rndr->cb.image(ob, u_link, title, content, rndr->opaque);
+		ret = rndr->cfg->cb.image(ob, u_link, title, content, rndr->opaque);
 	} else {
-		ret = rndr->cb.link(ob, u_link, title, content, rndr->opaque);
+		ret = rndr->cfg->cb.link(ob, u_link, title, content, rndr->opaque);
 	}
 
 	/* cleanup */
@@ -1079,7 +1773,7 @@ char_superscript(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t
 	size_t sup_start, sup_len;
 	struct buf *sup;
 
-	if (!rndr->cb.superscript)
+	if (!rndr->cfg->cb.superscript)
 		return 0;
 
 	if (size < 2)
@@ -1104,8 +1798,13 @@ char_superscript(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t
 		return (sup_start == 2) ? 3 : 0;
 
 	sup = rndr_newbuf(rndr, BUFFER_SPAN);
-	parse_inline(sup, rndr, data + sup_start, sup_len - sup_start);
-	rndr->cb.superscript(ob, sup, rndr->opaque);
+	if (rndr->cfg->events.enter)
+		span_node(ob, rndr, MKDN_SUPERSCRIPT, data + sup_start, sup_len - sup_start,
+			sup_start, sup_start - 1);
+	else {
+		parse_inline(sup, rndr, data + sup_start, sup_len - sup_start);
+		rndr->cfg->cb.superscript(ob, sup, rndr->opaque);
+	}
 	rndr_popbuf(rndr, BUFFER_SPAN);
 
 	return (sup_start == 2) ? sup_len + 1 : sup_len;
@@ -1128,6 +1827,155 @@ is_empty(uint8_t *data, size_t size)
 	return i + 1;
 }
 
+/* add_line • appends a line of the text to be parsed to the line table */
+/*	data holds the line up to its '\n', end is where it stops in the text */
+static void
+add_line(struct sd_markdown *md, const uint8_t *data, size_t size, size_t end)
+{
+	struct buf *work = md->line_work;
+	struct line_info ln;
+	int status = md->status;
+	size_t i = 0;
+
+	if (md->line_stop || md->status)
+		return;
+
+	while (data[i] == ' ')
+		i++;
+
+	ln.end = end;
+	ln.indent = (i < 255) ? (uint8_t)i : 255;
+	ln.first = data[i];
+	ln.pipe = (md->cfg->ext_flags & MKDEXT_TABLES) && memchr(data + i, '|', size - i);
+
+	/* the table only speeds up parsing: it gives way to the budget */
+	if (work->size + sizeof(ln) > work->asize &&
+		bufgrow(work, work->size + sizeof(ln)) < 0) {
+		md->status = status;
+		md->line_stop = 1;
+		return;
+	}
+
+	memcpy(work->data + work->size, &ln, sizeof(ln));
+	work->size += sizeof(ln);
+}
+
+/* reset_lines • empties the line table before a first pass */
+/*	the table is optional, and kept from one render to the next */
+static void
+reset_lines(struct sd_markdown *md)
+{
+	if (!md->line_work) {
+		md->line_work = bufnew_with(sizeof(struct line_info) * 64, md->alloc);
+		md->status = MKD_OK;
+	}
+
+	md->line_stop = (md->line_work == NULL);
+	if (md->line_work)
+		md->line_work->size = 0;
+}
+
+/* index_lines • hands the line table over to the block parsers */
+static void
+index_lines(struct sd_markdown *md, const uint8_t *data, size_t size)
+{
+	if (md->line_work) {
+		md->lines = (struct line_info *)md->line_work->data;
+		md->line_count = md->line_work->size / sizeof(struct line_info);
+	}
+
+	md->line_data = data;
+	md->line_size = size;
+	md->line_cur = 0;
+}
+
+/* line_at • line table entry for the line starting at data, if any */
+/*	only slices running to the end of the indexed text can use it: the
+ *	nested ones live in working buffers or in compacted blockquotes */
+static const struct line_info *
+line_at(struct sd_markdown *rndr, const uint8_t *data, size_t size, size_t *len)
+{
+	const struct line_info *lines = rndr->lines;
+	size_t off, lo, hi, mid, beg;
+
+	if (!rndr->line_count || size > rndr->line_size ||
+		data + size != rndr->line_data + rndr->line_size)
+		return NULL;
+
+	off = rndr->line_size - size;
+	lo = rndr->line_cur;
+
+	/* block parsers mostly walk the text forward */
+	if ((lo ? lines[lo - 1].end : 0) <= off) {
+		while (lo < rndr->line_count && lines[lo].end <= off)
+			lo++;
+	} else {
+		hi = lo;
+		lo = 0;
+
+		while (lo < hi) {
+			mid = lo + (hi - lo) / 2;
+			if (lines[mid].end <= off)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+	}
+
+	if (lo == rndr->line_count)
+		return NULL;
+
+	rndr->line_cur = lo;
+
+	/* blocks may stop right before the '\n' of their last line */
+	beg = lo ? lines[lo - 1].end : 0;
+	if (beg != off)
+		return NULL;
+
+	*len = lines[lo].end - beg;
+	return &lines[lo];
+}
+
+/* line_end • offset just past the line starting at data[beg] */
+static size_t
+line_end(struct sd_markdown *rndr, uint8_t *data, size_t beg, size_t size)
+{
+	const uint8_t *eol;
+	size_t len;
+
+	if (line_at(rndr, data + beg, size - beg, &len))
+		return beg + len;
+
+	eol = memchr(data + beg, '\n', size - beg);
+	return eol ? (size_t)(eol - data) + 1 : size;
+}
+
+/* line_empty • is_empty, answered by the line table when possible */
+static size_t
+line_empty(struct sd_markdown *rndr, uint8_t *data, size_t size)
+{
+	const struct line_info *ln;
+	size_t len;
+
+	if ((ln = line_at(rndr, data, size, &len)) != NULL)
+		return ln->first == '\n' ? len : 0;
+
+	return is_empty(data, size);
+}
+
+/* line_plain • whether a line can only start a paragraph */
+/*	no other block starts with a letter, unless the line is indented
+ *	as code or holds a pipe for the tables */
+static int
+line_plain(struct sd_markdown *rndr, uint8_t *data, size_t size)
+{
+	const struct line_info *ln;
+	size_t len;
+
+	ln = line_at(rndr, data, size, &len);
+	return ln && ln->indent < 4 && isalpha(ln->first) && !ln->pipe;
+}
+
 /* is_hrule • returns whether a line is a horizontal rule */
 static int
 is_hrule(uint8_t *data, size_t size)
@@ -1254,7 +2102,7 @@ is_atxheader(struct sd_markdown *rndr, uint8_t *data, size_t size)
 	if (data[0] != '#')
 		return 0;
 
-	if (rndr->ext_flags & MKDEXT_SPACE_HEADERS) {
+	if (rndr->cfg->ext_flags & MKDEXT_SPACE_HEADERS) {
 		size_t level = 0;
 
 		while (level < size && level < 6 && data[level] == '#')
@@ -1291,12 +2139,10 @@ is_headerline(uint8_t *data, size_t size)
 static int
 is_next_headerline(uint8_t *data, size_t size)
 {
-	size_t i = 0;
-
-	while (i < size && data[i] != '\n')
-		i++;
+	const uint8_t *eol = memchr(data, '\n', size);
+	size_t i;
 
-	if (++i >= size)
+	if (!eol || (i = (size_t)(eol - data) + 1) >= size)
 		return 0;
 
 	return is_headerline(data + i, size - i);
@@ -1382,6 +2228,46 @@ prefix_uli(uint8_t *data, size_t size)
 static void parse_block(struct buf *ob, struct sd_markdown *rndr,
 			uint8_t *data, size_t size);
 
+/* block_node • emits a block node around the parse of data, as blocks
+ * or as spans */
+static void
+block_node(struct buf *ob, struct sd_markdown *rndr, struct sd_node *node,
+	uint8_t *data, size_t size, int spans)
+{
+	if (!node_enter(ob, rndr, node))
+		return;
+
+	if (spans)
+		parse_inline(ob, rndr, data, size);
+	else
+		parse_block(ob, rndr, data, size);
+
+	node_leave(ob, rndr, node);
+}
+
+/* block_text • emits a leaf block, or hands it to its callback */
+static void
+block_text(struct buf *ob, struct sd_markdown *rndr, enum mkd_node type,
+	const struct buf *text, const struct buf *lang)
+{
+	struct sd_node node;
+
+	if (!rndr->cfg->events.enter) {
+		if (type == MKDN_BLOCKHTML && rndr->cfg->cb.blockhtml)
+			rndr->cfg->cb.blockhtml(ob, text, rndr->opaque);
+		else if (type == MKDN_BLOCKCODE && rndr->cfg->cb.blockcode)
+			rndr->cfg->cb.blockcode(ob, text, lang, rndr->opaque);
+		else if (type == MKDN_HRULE && rndr->cfg->cb.hrule)
+			rndr->cfg->cb.hrule(ob, rndr->opaque);
+		return;
+	}
+
+	node_init(&node, type);
+	node.text = text;
+	node.lang = lang;
+	node_leaf(ob, rndr, &node);
+}
+
 
 /* parse_blockquote • handles parsing of a blockquote fragment */
 static size_t
@@ -1389,12 +2275,26 @@ parse_blockquote(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t
 {
 	size_t beg, end = 0, pre, work_size = 0;
 	uint8_t *work_data = 0;
-	struct buf *out = 0;
+	struct buf *out = 0, *copy = 0;
+
+	/* the caller's document is read-only: strip the prefixes into a copy */
+	if (rndr->in_place &&
+		rndr->work_bufs[BUFFER_SPAN].size + rndr->work_bufs[BUFFER_BLOCK].size == 0) {
+		if (!rndr->quote_work) {
+			rndr->quote_work = bufnew_with(256, rndr->alloc);
+			if (!rndr->quote_work)
+				return size;
+			rndr->quote_work->growth = BUF_GROW_CAPPED;
+		}
+
+		copy = rndr->quote_work;
+		copy->size = 0;
+	}
 
 	out = rndr_newbuf(rndr, BUFFER_BLOCK);
 	beg = 0;
 	while (beg < size) {
-		for (end = beg + 1; end < size && data[end - 1] != '\n'; end++);
+		end = line_end(rndr, data, beg, size);
 
 		pre = prefix_quote(data + beg, end - beg);
 
@@ -1402,13 +2302,15 @@ parse_blockquote(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t
 			beg += pre; /* skipping prefix */
 
 		/* empty line followed by non-quote line */
-		else if (is_empty(data + beg, end - beg) &&
+		else if (line_empty(rndr, data + beg, size - beg) &&
 				(end >= size || (prefix_quote(data + end, size - end) == 0 &&
-				!is_empty(data + end, size - end))))
+				!line_empty(rndr, data + end, size - end))))
 			break;
 
-		if (beg < end) { /* copy into the in-place working buffer */
-			/* bufput(work, data + beg, end - beg); */
+		if (beg < end && copy)
+			bufput(copy, data + beg, end - beg);
+
+		else if (beg < end) { /* copy into the in-place working buffer */
 			if (!work_data)
 				work_data = data + beg;
 			else if (data + beg != work_data + work_size)
@@ -1418,9 +2320,21 @@ parse_blockquote(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t
 		beg = end;
 	}
 
-	parse_block(out, rndr, work_data, work_size);
-	if (rndr->cb.blockquote)
-		rndr->cb.blockquote(ob, out, rndr->opaque);
+	if (copy) {
+		work_data = copy->data;
+		work_size = copy->size;
+	}
+
+	if (rndr->cfg->events.enter) {
+		struct sd_node node;
+
+		node_init(&node, MKDN_BLOCKQUOTE);
+		block_node(ob, rndr, &node, work_data, work_size, 0);
+	} else {
+		parse_block(out, rndr, work_data, work_size);
+		if (rndr->cfg->cb.blockquote)
+			rndr->cfg->cb.blockquote(ob, out, rndr->opaque);
+	}
 	rndr_popbuf(rndr, BUFFER_BLOCK);
 	return end;
 }
@@ -1428,18 +2342,67 @@ parse_blockquote(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t
 static size_t
 parse_htmlblock(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t size, int do_render);
 
+/* paragraph_render • parses and renders the text of a paragraph */
+static void
+paragraph_render(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t size)
+{
+	struct buf *tmp = rndr_newbuf(rndr, BUFFER_BLOCK);
+
+	if (rndr->cfg->events.enter) {
+		struct sd_node node;
+
+		node_init(&node, MKDN_PARAGRAPH);
+		block_node(ob, rndr, &node, data, size, 1);
+	} else {
+		parse_inline(tmp, rndr, data, size);
+		if (rndr->cfg->cb.paragraph)
+			rndr->cfg->cb.paragraph(ob, tmp, rndr->opaque);
+	}
+
+	rndr_popbuf(rndr, BUFFER_BLOCK);
+}
+
+/* header_render • parses and renders the text of a header */
+static void
+header_render(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t size, size_t level)
+{
+	struct buf *work = rndr_newbuf(rndr, BUFFER_SPAN);
+
+	if (rndr->cfg->events.enter) {
+		struct sd_node node;
+
+		node_init(&node, MKDN_HEADER);
+		node.level = (int)level;
+		block_node(ob, rndr, &node, data, size, 1);
+	} else {
+		parse_inline(work, rndr, data, size);
+		if (rndr->cfg->cb.header)
+			rndr->cfg->cb.header(ob, work, (int)level, rndr->opaque);
+	}
+
+	rndr_popbuf(rndr, BUFFER_SPAN);
+}
+
 /* parse_blockquote • handles parsing of a regular paragraph */
 static size_t
 parse_paragraph(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t size)
 {
-	size_t i = 0, end = 0;
+	size_t i = 0, end = 0, len;
 	int level = 0;
 	struct buf work = { data, 0, 0, 0 };
+	const struct line_info *ln;
 
 	while (i < size) {
-		for (end = i + 1; end < size && data[end - 1] != '\n'; end++) /* empty */;
+		/* a line starting with a letter just carries on the paragraph */
+		ln = line_at(rndr, data + i, size - i, &len);
+		if (ln && isalpha(ln->first)) {
+			i = end = i + len;
+			continue;
+		}
 
-		if (is_empty(data + i, size - i))
+		end = line_end(rndr, data, i, size);
+
+		if (line_empty(rndr, data + i, size - i))
 			break;
 
 		if ((level = is_headerline(data + i, size - i)) != 0)
@@ -1461,7 +2424,7 @@ parse_paragraph(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t
 		 * let's check to see if there's some kind of block starting
 		 * here
 		 */
-		if ((rndr->ext_flags & MKDEXT_LAX_SPACING) && !isalnum(data[i])) {
+		if ((rndr->cfg->ext_flags & MKDEXT_LAX_SPACING) && !isalnum(data[i])) {
 			if (prefix_oli(data + i, size - i) ||
 				prefix_uli(data + i, size - i)) {
 				end = i;
@@ -1469,14 +2432,15 @@ parse_paragraph(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t
 			}
 
 			/* see if an html block starts here */
-			if (data[i] == '<' && rndr->cb.blockhtml &&
-				parse_htmlblock(ob, rndr, data + i, size - i, 0)) {
+			if (data[i] == '<' && rndr->cfg->cb.blockhtml &&
+				STAT_BLOCK(rndr, MKDS_HTMLBLOCK,
+					parse_htmlblock(ob, rndr, data + i, size - i, 0))) {
 				end = i;
 				break;
 			}
 
 			/* see if a code fence starts here */
-			if ((rndr->ext_flags & MKDEXT_FENCED_CODE) != 0 &&
+			if ((rndr->cfg->ext_flags & MKDEXT_FENCED_CODE) != 0 &&
 				is_codefence(data + i, size - i, NULL) != 0) {
 				end = i;
 				break;
@@ -1490,15 +2454,9 @@ parse_paragraph(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t
 	while (work.size && data[work.size - 1] == '\n')
 		work.size--;
 
-	if (!level) {
-		struct buf *tmp = rndr_newbuf(rndr, BUFFER_BLOCK);
-		parse_inline(tmp, rndr, work.data, work.size);
-		if (rndr->cb.paragraph)
-			rndr->cb.paragraph(ob, tmp, rndr->opaque);
-		rndr_popbuf(rndr, BUFFER_BLOCK);
-	} else {
-		struct buf *header_work;
-
+	if (!level)
+		paragraph_render(ob, rndr, work.data, work.size);
+	else {
 		if (work.size) {
 			size_t beg;
 			i = work.size;
@@ -1512,26 +2470,14 @@ parse_paragraph(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t
 				work.size -= 1;
 
 			if (work.size > 0) {
-				struct buf *tmp = rndr_newbuf(rndr, BUFFER_BLOCK);
-				parse_inline(tmp, rndr, work.data, work.size);
-
-				if (rndr->cb.paragraph)
-					rndr->cb.paragraph(ob, tmp, rndr->opaque);
-
-				rndr_popbuf(rndr, BUFFER_BLOCK);
+				paragraph_render(ob, rndr, work.data, work.size);
 				work.data += beg;
 				work.size = i - beg;
 			}
 			else work.size = i;
 		}
 
-		header_work = rndr_newbuf(rndr, BUFFER_SPAN);
-		parse_inline(header_work, rndr, work.data, work.size);
-
-		if (rndr->cb.header)
-			rndr->cb.header(ob, header_work, (int)level, rndr->opaque);
-
-		rndr_popbuf(rndr, BUFFER_SPAN);
+		header_render(ob, rndr, work.data, work.size, level);
 	}
 
 	return end;
@@ -1560,12 +2506,12 @@ parse_fencedcode(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t
 			break;
 		}
 
-		for (end = beg + 1; end < size && data[end - 1] != '\n'; end++);
+		end = line_end(rndr, data, beg, size);
 
 		if (beg < end) {
 			/* verbatim copy to the working buffer,
 				escaping entities */
-			if (is_empty(data + beg, end - beg))
+			if (line_empty(rndr, data + beg, size - beg))
 				bufputc(work, '\n');
 			else bufput(work, data + beg, end - beg);
 		}
@@ -1575,8 +2521,7 @@ parse_fencedcode(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t
 	if (work->size && work->data[work->size - 1] != '\n')
 		bufputc(work, '\n');
 
-	if (rndr->cb.blockcode)
-		rndr->cb.blockcode(ob, work, lang.size ? &lang : NULL, rndr->opaque);
+	block_text(ob, rndr, MKDN_BLOCKCODE, work, lang.size ? &lang : NULL);
 
 	rndr_popbuf(rndr, BUFFER_BLOCK);
 	return beg;
@@ -1592,12 +2537,12 @@ parse_blockcode(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t
 
 	beg = 0;
 	while (beg < size) {
-		for (end = beg + 1; end < size && data[end - 1] != '\n'; end++) {};
+		end = line_end(rndr, data, beg, size);
 		pre = prefix_code(data + beg, end - beg);
 
 		if (pre)
 			beg += pre; /* skipping prefix */
-		else if (!is_empty(data + beg, end - beg))
+		else if (!line_empty(rndr, data + beg, size - beg))
 			/* non-empty non-prefixed line breaks the pre */
 			break;
 
@@ -1616,8 +2561,7 @@ parse_blockcode(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t
 
 	bufputc(work, '\n');
 
-	if (rndr->cb.blockcode)
-		rndr->cb.blockcode(ob, work, NULL, rndr->opaque);
+	block_text(ob, rndr, MKDN_BLOCKCODE, work, NULL);
 
 	rndr_popbuf(rndr, BUFFER_BLOCK);
 	return beg;
@@ -1631,6 +2575,7 @@ parse_listitem(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t s
 	struct buf *work = 0, *inter = 0;
 	size_t beg = 0, end, pre, sublist = 0, orgpre = 0, i;
 	int in_empty = 0, has_inside_empty = 0, in_fence = 0;
+	struct sd_node node;
 
 	/* keeping track of the first indentation prefix */
 	while (orgpre < 3 && orgpre < size && data[orgpre] == ' ')
@@ -1660,13 +2605,10 @@ parse_listitem(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t s
 	while (beg < size) {
 		size_t has_next_uli = 0, has_next_oli = 0;
 
-		end++;
-
-		while (end < size && data[end - 1] != '\n')
-			end++;
+		end = line_end(rndr, data, beg, size);
 
 		/* process an empty line */
-		if (is_empty(data + beg, end - beg)) {
+		if (line_empty(rndr, data + beg, size - beg)) {
 			in_empty = 1;
 			beg = end;
 			continue;
@@ -1679,7 +2621,7 @@ parse_listitem(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t s
 
 		pre = i;
 
-		if (rndr->ext_flags & MKDEXT_FENCED_CODE) {
+		if (rndr->cfg->ext_flags & MKDEXT_FENCED_CODE) {
 			if (is_codefence(data + beg + i, end - beg - i, NULL) != 0)
 				in_fence = !in_fence;
 		}
@@ -1733,6 +2675,18 @@ parse_listitem(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t s
 	if (has_inside_empty)
 		*flags |= MKD_LI_BLOCK;
 
+	if (!ob)
+		goto done;
+
+	if (rndr->cfg->events.enter) {
+		node_init(&node, MKDN_LISTITEM);
+		node.flags = *flags;
+		if (!node_enter(ob, rndr, &node))
+			goto done;
+
+		inter = ob;
+	}
+
 	if (*flags & MKD_LI_BLOCK) {
 		/* intermediate render of block li */
 		if (sublist && sublist < work->size) {
@@ -1752,9 +2706,12 @@ parse_listitem(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t s
 	}
 
 	/* render of li itself */
-	if (rndr->cb.listitem)
-		rndr->cb.listitem(ob, inter, *flags, rndr->opaque);
+	if (rndr->cfg->events.enter)
+		node_leave(ob, rndr, &node);
+	else if (rndr->cfg->cb.listitem)
+		rndr->cfg->cb.listitem(ob, inter, *flags, rndr->opaque);
 
+done:
 	rndr_popbuf(rndr, BUFFER_SPAN);
 	rndr_popbuf(rndr, BUFFER_SPAN);
 	return beg;
@@ -1767,19 +2724,35 @@ parse_list(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t size,
 {
 	struct buf *work = 0;
 	size_t i = 0, j;
+	struct sd_node node;
+	int entered = 0;
 
 	work = rndr_newbuf(rndr, BUFFER_BLOCK);
 
+	/* the items of a dropped list are parsed through, not rendered */
+	if (rndr->cfg->events.enter) {
+		node_init(&node, MKDN_LIST);
+		node.flags = flags;
+		entered = node_enter(ob, rndr, &node);
+		work = entered ? ob : NULL;
+	}
+
 	while (i < size) {
-		j = parse_listitem(work, rndr, data + i, size - i, &flags);
+		j = STAT_BLOCK(rndr, MKDS_LISTITEM,
+			parse_listitem(work, rndr, data + i, size - i, &flags));
 		i += j;
 
 		if (!j || (flags & MKD_LI_END))
 			break;
 	}
 
-	if (rndr->cb.list)
-		rndr->cb.list(ob, work, flags, rndr->opaque);
+	if (rndr->cfg->events.enter) {
+		node.flags = flags;
+		if (entered)
+			node_leave(ob, rndr, &node);
+	}
+	else if (rndr->cfg->cb.list)
+		rndr->cfg->cb.list(ob, work, flags, rndr->opaque);
 	rndr_popbuf(rndr, BUFFER_BLOCK);
 	return i;
 }
@@ -1805,16 +2778,8 @@ parse_atxheader(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t
 	while (end && data[end - 1] == ' ')
 		end--;
 
-	if (end > i) {
-		struct buf *work = rndr_newbuf(rndr, BUFFER_SPAN);
-
-		parse_inline(work, rndr, data + i, end - i);
-
-		if (rndr->cb.header)
-			rndr->cb.header(ob, work, (int)level, rndr->opaque);
-
-		rndr_popbuf(rndr, BUFFER_SPAN);
-	}
+	if (end > i)
+		header_render(ob, rndr, data + i, end - i, level);
 
 	return skip;
 }
@@ -1852,12 +2817,15 @@ htmlblock_end_tag(
 	return i + w;
 }
 
+/* htmlblock_end • looking for the closing tag of an HTML block */
+/*	with first_line set, gives up on the first newline it counts */
 static size_t
 htmlblock_end(const char *curtag,
 	struct sd_markdown *rndr,
 	uint8_t *data,
 	size_t size,
-	int start_of_line)
+	int start_of_line,
+	int first_line)
 {
 	size_t tag_size = strlen(curtag);
 	size_t i = 1, end_tag;
@@ -1866,8 +2834,11 @@ htmlblock_end(const char *curtag,
 	while (i < size) {
 		i++;
 		while (i < size && !(data[i - 1] == '<' && data[i] == '/')) {
-			if (data[i] == '\n')
+			if (data[i] == '\n') {
+				if (first_line)
+					return 0;
 				block_lines++;
+			}
 
 			i++;
 		}
@@ -1893,6 +2864,58 @@ htmlblock_end(const char *curtag,
 	return 0;
 }
 
+/* htmlblock_find • htmlblock_end, skipping searches known to fail */
+/*	Candidates are judged by their absolute position, so a search that
+ *	failed from an earlier block start of the same text fails from any
+ *	later one too. The only exception are unindented-mode candidates on
+ *	the first line of the new block, which are still worth a look. */
+static size_t
+htmlblock_find(const char *curtag,
+	struct sd_markdown *rndr,
+	uint8_t *data,
+	size_t size,
+	int start_of_line)
+{
+	struct html_span *span = rndr->html_span;
+	uint8_t **failed = NULL;
+	size_t n, tag_end;
+
+	if (span && span->end == data + size) {
+		for (n = 0; n < span->count && span->tags[n].tag != curtag; n++)
+			/* empty */;
+
+		if (n == span->count && n < HTML_SPAN_TAGS) {
+			span->tags[n].tag = curtag;
+			span->tags[n].failed[0] = NULL;
+			span->tags[n].failed[1] = NULL;
+			span->count++;
+		}
+
+		if (n < span->count)
+			failed = &span->tags[n].failed[start_of_line != 0];
+	}
+
+	if (failed && *failed && *failed <= data)
+		return start_of_line ?
+			htmlblock_end(curtag, rndr, data, size, 1, 1) : 0;
+
+	tag_end = htmlblock_end(curtag, rndr, data, size, start_of_line, 0);
+	if (!tag_end && failed && !*failed)
+		*failed = data;
+
+	return tag_end;
+}
+
+
+/* html_seen • notes how far an HTML block search looked into the text */
+/*	only searches over the text of the top-level blocks count */
+static void
+html_seen(struct sd_markdown *rndr, uint8_t *data, size_t size, size_t seen)
+{
+	if (data + size == rndr->line_data + rndr->line_size &&
+		(size_t)(data + seen - rndr->line_data) > rndr->html_reach)
+		rndr->html_reach = data + seen - rndr->line_data;
+}
 
 /* parse_htmlblock • parsing of inline HTML block */
 static size_t
@@ -1910,6 +2933,8 @@ parse_htmlblock(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t
 	while (i < size && data[i] != '>' && data[i] != ' ')
 		i++;
 
+	html_seen(rndr, data, size, i);
+
 	if (i < size)
 		curtag = find_block_tag((char *)data + 1, (int)i - 1);
 
@@ -1924,14 +2949,15 @@ parse_htmlblock(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t
 				i++;
 
 			i++;
+			html_seen(rndr, data, size, i < size ? i : size);
 
 			if (i < size)
 				j = is_empty(data + i, size - i);
 
 			if (j) {
 				work.size = i + j;
-				if (do_render && rndr->cb.blockhtml)
-					rndr->cb.blockhtml(ob, &work, rndr->opaque);
+				if (do_render)
+					block_text(ob, rndr, MKDN_BLOCKHTML, &work, NULL);
 				return work.size;
 			}
 		}
@@ -1942,13 +2968,15 @@ parse_htmlblock(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t
 			while (i < size && data[i] != '>')
 				i++;
 
+			html_seen(rndr, data, size, i);
+
 			if (i + 1 < size) {
 				i++;
 				j = is_empty(data + i, size - i);
 				if (j) {
 					work.size = i + j;
-					if (do_render && rndr->cb.blockhtml)
-						rndr->cb.blockhtml(ob, &work, rndr->opaque);
+					if (do_render)
+						block_text(ob, rndr, MKDN_BLOCKHTML, &work, NULL);
 					return work.size;
 				}
 			}
@@ -1960,12 +2988,13 @@ parse_htmlblock(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t
 
 	/* looking for an unindented matching closing tag */
 	/*	followed by a blank line */
-	tag_end = htmlblock_end(curtag, rndr, data, size, 1);
+	tag_end = htmlblock_find(curtag, rndr, data, size, 1);
+	html_seen(rndr, data, size, tag_end ? tag_end : size);
 
 	/* if not found, trying a second pass looking for indented match */
 	/* but not if tag is "ins" or "del" (following original Markdown.pl) */
 	if (!tag_end && strcmp(curtag, "ins") != 0 && strcmp(curtag, "del") != 0) {
-		tag_end = htmlblock_end(curtag, rndr, data, size, 0);
+		tag_end = htmlblock_find(curtag, rndr, data, size, 0);
 	}
 
 	if (!tag_end)
@@ -1973,8 +3002,8 @@ parse_htmlblock(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t
 
 	/* the end of the block has been found */
 	work.size = tag_end;
-	if (do_render && rndr->cb.blockhtml)
-		rndr->cb.blockhtml(ob, &work, rndr->opaque);
+	if (do_render)
+		block_text(ob, rndr, MKDN_BLOCKHTML, &work, NULL);
 
 	return tag_end;
 }
@@ -1991,12 +3020,23 @@ parse_table_row(
 {
 	size_t i = 0, col;
 	struct buf *row_work = 0;
+	struct sd_node row, cell;
 
-	if (!rndr->cb.table_cell || !rndr->cb.table_row)
+	if (!rndr->cfg->cb.table_cell || !rndr->cfg->cb.table_row)
 		return;
 
 	row_work = rndr_newbuf(rndr, BUFFER_SPAN);
 
+	if (rndr->cfg->events.enter) {
+		node_init(&row, MKDN_TABLE_ROW);
+		if (!node_enter(ob, rndr, &row)) {
+			rndr_popbuf(rndr, BUFFER_SPAN);
+			return;
+		}
+
+		row_work = ob;
+	}
+
 	if (i < size && data[i] == '|')
 		i++;
 
@@ -2019,8 +3059,14 @@ parse_table_row(
 		while (cell_end > cell_start && _isspace(data[cell_end]))
 			cell_end--;
 
-		parse_inline(cell_work, rndr, data + cell_start, 1 + cell_end - cell_start);
-		rndr->cb.table_cell(row_work, cell_work, col_data[col] | header_flag, rndr->opaque);
+		if (rndr->cfg->events.enter) {
+			node_init(&cell, MKDN_TABLE_CELL);
+			cell.flags = col_data[col] | header_flag;
+			block_node(row_work, rndr, &cell, data + cell_start, 1 + cell_end - cell_start, 1);
+		} else {
+			parse_inline(cell_work, rndr, data + cell_start, 1 + cell_end - cell_start);
+			rndr->cfg->cb.table_cell(row_work, cell_work, col_data[col] | header_flag, rndr->opaque);
+		}
 
 		rndr_popbuf(rndr, BUFFER_SPAN);
 		i++;
@@ -2028,22 +3074,31 @@ parse_table_row(
 
 	for (; col < columns; ++col) {
 		struct buf empty_cell = { 0, 0, 0, 0 };
-		rndr->cb.table_cell(row_work, &empty_cell, col_data[col] | header_flag, rndr->opaque);
+
+		if (rndr->cfg->events.enter) {
+			node_init(&cell, MKDN_TABLE_CELL);
+			cell.flags = col_data[col] | header_flag;
+			block_node(row_work, rndr, &cell, NULL, 0, 1);
+		} else
+			rndr->cfg->cb.table_cell(row_work, &empty_cell, col_data[col] | header_flag, rndr->opaque);
 	}
 
-	rndr->cb.table_row(ob, row_work, rndr->opaque);
+	if (rndr->cfg->events.enter)
+		node_leave(ob, rndr, &row);
+	else
+		rndr->cfg->cb.table_row(ob, row_work, rndr->opaque);
 
 	rndr_popbuf(rndr, BUFFER_SPAN);
 }
 
 static size_t
 parse_table_header(
-	struct buf *ob,
 	struct sd_markdown *rndr,
 	uint8_t *data,
 	size_t size,
 	size_t *columns,
-	int **column_data)
+	int **column_data,
+	size_t *header_size)
 {
 	int pipes;
 	size_t i = 0, col, header_end, under_end;
@@ -2068,7 +3123,11 @@ parse_table_header(
 		pipes--;
 
 	*columns = pipes + 1;
-	*column_data = calloc(*columns, sizeof(int));
+	*column_data = bufmem_alloc(rndr->alloc, *columns * sizeof(int));
+	if (!*column_data)
+		return 0;
+
+	memset(*column_data, 0x0, *columns * sizeof(int));
 
 	/* Parse the header underline */
 	i++;
@@ -2114,14 +3173,7 @@ parse_table_header(
 	if (col < *columns)
 		return 0;
 
-	parse_table_row(
-		ob, rndr, data,
-		header_end,
-		*columns,
-		*column_data,
-		MKD_TABLE_HEADER
-	);
-
+	*header_size = header_end;
 	return under_end + 1;
 }
 
@@ -2132,19 +3184,38 @@ parse_table(
 	uint8_t *data,
 	size_t size)
 {
-	size_t i;
+	size_t i, header_size = 0;
 
 	struct buf *header_work = 0;
 	struct buf *body_work = 0;
+	struct sd_node table, part;
+	int entered = 0;
 
-	size_t columns;
+	size_t columns = 0;
 	int *col_data = NULL;
 
 	header_work = rndr_newbuf(rndr, BUFFER_SPAN);
 	body_work = rndr_newbuf(rndr, BUFFER_BLOCK);
 
-	i = parse_table_header(header_work, rndr, data, size, &columns, &col_data);
+	i = parse_table_header(rndr, data, size, &columns, &col_data, &header_size);
 	if (i > 0) {
+		/* the rows of a dropped table are skipped over */
+		if (rndr->cfg->events.enter) {
+			node_init(&table, MKDN_TABLE);
+			entered = node_enter(ob, rndr, &table);
+			body_work = entered ? ob : NULL;
+
+			node_init(&part, MKDN_TABLE_HEADER);
+			if (entered && node_enter(ob, rndr, &part)) {
+				parse_table_row(ob, rndr, data, header_size, columns, col_data, MKD_TABLE_HEADER);
+				node_leave(ob, rndr, &part);
+			}
+
+			node_init(&part, MKDN_TABLE_BODY);
+			if (entered && !node_enter(ob, rndr, &part))
+				body_work = NULL;
+		} else
+			parse_table_row(header_work, rndr, data, header_size, columns, col_data, MKD_TABLE_HEADER);
 
 		while (i < size) {
 			size_t row_start;
@@ -2161,87 +3232,319 @@ parse_table(
 				break;
 			}
 
-			parse_table_row(
-				body_work,
-				rndr,
-				data + row_start,
-				i - row_start,
-				columns,
-				col_data, 0
-			);
+			if (body_work)
+				parse_table_row(
+					body_work,
+					rndr,
+					data + row_start,
+					i - row_start,
+					columns,
+					col_data, 0
+				);
 
 			i++;
 		}
 
-		if (rndr->cb.table)
-			rndr->cb.table(ob, header_work, body_work, rndr->opaque);
+		if (rndr->cfg->events.enter) {
+			if (body_work)
+				node_leave(ob, rndr, &part);
+			if (entered)
+				node_leave(ob, rndr, &table);
+		}
+		else if (rndr->cfg->cb.table)
+			rndr->cfg->cb.table(ob, header_work, body_work, rndr->opaque);
 	}
 
-	free(col_data);
+	bufmem_free(rndr->alloc, col_data, columns * sizeof(int));
 	rndr_popbuf(rndr, BUFFER_SPAN);
 	rndr_popbuf(rndr, BUFFER_BLOCK);
 	return i;
 }
 
-/* parse_block • parsing of one block, returning next uint8_t to parse */
+/* rndr_flush • hands the pending output over to the sink */
+/*	the last byte is kept back: renderers peek at it to separate blocks */
 static void
-parse_block(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t size)
+rndr_flush(struct buf *ob, struct sd_markdown *rndr, size_t keep)
 {
-	size_t beg, end, i;
-	uint8_t *txt_data;
-	beg = 0;
-
-	if (rndr->work_bufs[BUFFER_SPAN].size +
-		rndr->work_bufs[BUFFER_BLOCK].size > rndr->max_nesting)
+	if (ob->size <= keep || rndr->status)
 		return;
 
-	while (beg < size) {
-		txt_data = data + beg;
-		end = size - beg;
+	if (rndr->sink(ob->data, ob->size - keep, rndr->sink_opaque) != 0) {
+		rndr->status = MKD_ESINK;
+		return;
+	}
 
-		if (is_atxheader(rndr, txt_data, end))
-			beg += parse_atxheader(ob, rndr, txt_data, end);
+	if (keep)
+		memmove(ob->data, ob->data + ob->size - keep, keep);
+	ob->size = keep;
+}
 
-		else if (data[beg] == '<' && rndr->cb.blockhtml &&
-				(i = parse_htmlblock(ob, rndr, txt_data, end, 1)) != 0)
-			beg += i;
+/* block_mark: where a top-level block starts, and the output before it */
+struct block_mark {
+	size_t beg;
+	size_t out;
+	size_t reach;	/* furthest byte its HTML block searches looked at, or 0 */
+};
 
-		else if ((i = is_empty(txt_data, end)) != 0)
-			beg += i;
+/* block_reach • end of the line after the first one holding text from end on */
+/*	the block parsers look that far past a block to find where it ends:
+ *	a list item marker is only one when no header underline follows */
+static size_t
+block_reach(const uint8_t *data, size_t size, size_t end)
+{
+	const uint8_t *eol;
+	size_t w;
+	int n;
 
-		else if (is_hrule(txt_data, end)) {
-			if (rndr->cb.hrule)
-				rndr->cb.hrule(ob, rndr->opaque);
+	while (end < size && (w = is_empty((uint8_t *)data + end, size - end)) != 0)
+		end += w;
 
-			while (beg < size && data[beg] != '\n')
-				beg++;
+	for (n = 0; n < 2 && end < size; ++n) {
+		eol = memchr(data + end, '\n', size - end);
+		end = eol ? (size_t)(eol - data) + 1 : size;
+	}
 
-			beg++;
-		}
+	return end;
+}
 
-		else if ((rndr->ext_flags & MKDEXT_FENCED_CODE) != 0 &&
-			(i = parse_fencedcode(ob, rndr, txt_data, end)) != 0)
-			beg += i;
+/* block_seed • last output byte, as the renderers see it */
+static int
+block_seed(const struct buf *ob, size_t out)
+{
+	return out ? ob->data[out - 1] : -1;
+}
 
-		else if ((rndr->ext_flags & MKDEXT_TABLES) != 0 &&
-			(i = parse_table(ob, rndr, txt_data, end)) != 0)
+/* cache_block_get • copies a top-level block from the cache */
+/*	returns its size, or 0 after setting up the parse of a block that
+ *	may go in the cache. An entry fits when the text its parse could
+ *	look at, the output byte before it and every reference it looked
+ *	up are the same */
+static size_t
+cache_block_get(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t size, size_t beg)
+{
+	struct sd_cache *cache = rndr->cache;
+	struct cache_entry *entry = NULL;
+	struct block_key key;
+	struct block_ref ref;
+	const uint8_t *eol, *p, *refs_end;
+	int seed = block_seed(ob, ob->size);
+
+	if (data[beg] == '\n')
+		return 0;
+
+	eol = memchr(data + beg, '\n', size - beg);
+	rndr->cache_hash = bufhash(data + beg, eol ? (size_t)(eol - data) + 1 - beg : size - beg,
+		rndr->cache_settings ^ (uint64_t)(seed + 1));
+
+	while ((entry = cache_next(cache, entry, rndr->cache_hash, rndr->cache_settings)) != NULL) {
+		memcpy(&key, entry->data, sizeof(key));
+
+		if (key.seed != seed || key.span > size - beg ||
+			(key.at_end && key.span != size - beg) ||
+			memcmp(entry->data + sizeof(key), data + beg, key.span) != 0)
+			continue;
+
+		p = entry->data + sizeof(key) + key.span;
+		refs_end = p + key.refs_size;
+
+		while (p < refs_end) {
+			memcpy(&ref, p, sizeof(ref));
+			p += sizeof(ref);
+			if (ref_hash(lookup_link_ref(rndr, p, ref.name_size)) != ref.hash)
+				break;
+			p += ref.name_size;
+		}
+
+		if (p < refs_end)
+			continue;
+
+		cache->stats.block_hits++;
+		cache_touch(cache, entry);
+		bufput(ob, CACHE_VALUE(entry), entry->value_size);
+		return key.size;
+	}
+
+	cache->stats.block_misses++;
+	rndr->cache_block = 1;
+	rndr->cache_refs->size = 0;
+	rndr->html_reach = 0;
+	return 0;
+}
+
+/* cache_block_put • keeps the output of the top-level block just parsed */
+static void
+cache_block_put(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t size,
+	size_t beg, size_t end, size_t out)
+{
+	struct block_key key;
+	size_t reach;
+
+	if (!rndr->cache_block)
+		return;
+
+	rndr->cache_block = 0;
+
+	if (rndr->status || ob->size == out)
+		return;
+
+	/* everything its parse may have looked at */
+	reach = block_reach(data, size, end);
+	if (rndr->html_reach && block_reach(data, size, rndr->html_reach) > reach)
+		reach = block_reach(data, size, rndr->html_reach);
+
+	/* the last block may be taken to end past the text */
+	if (reach > size)
+		reach = size;
+
+	if (reach - beg > CACHE_BLOCK_MAX)
+		return;
+
+	key.size = end - beg;
+	key.span = reach - beg;
+	key.refs_size = rndr->cache_refs->size;
+	key.seed = block_seed(ob, out);
+	key.at_end = (reach == size);
+
+	rndr->cache_key->size = 0;
+	bufput(rndr->cache_key, &key, sizeof(key));
+	bufput(rndr->cache_key, data + beg, key.span);
+	if (rndr->cache_refs->size)
+		bufput(rndr->cache_key, rndr->cache_refs->data, rndr->cache_refs->size);
+
+	if (rndr->cache_key->size == sizeof(key) + key.span + key.refs_size)
+		cache_insert(rndr->cache, rndr->cache_hash, rndr->cache_settings,
+			rndr->cache_key->data, rndr->cache_key->size, ob->data + out, ob->size - out);
+}
+
+/* parse_block_range • parsing of the blocks starting before stop */
+/*	returns where the last of them ends, which may be past stop;
+ *	marks, when given, gets a block_mark for each of them */
+static size_t
+parse_block_range(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t size,
+	size_t beg, size_t stop, struct buf *marks)
+{
+	size_t end, i, hit = 0;
+	uint8_t *txt_data;
+	struct html_span span, *parent_span;
+	struct block_mark mark;
+	int cached, in_place = rndr->in_place;
+
+	if (rndr->work_bufs[BUFFER_SPAN].size +
+		rndr->work_bufs[BUFFER_BLOCK].size > rndr->cfg->max_nesting)
+		return beg;
+
+	/* only blocks of the whole text are cached, without block marks */
+	cached = rndr->cache && !marks &&
+		data == rndr->line_data && size == rndr->line_size &&
+		rndr->work_bufs[BUFFER_SPAN].size + rndr->work_bufs[BUFFER_BLOCK].size == 0;
+
+	/* keys are taken from the text after the parse: blockquotes must
+	 * not compact it */
+	if (cached)
+		rndr->in_place = 1;
+
+	span.end = data + size;
+	span.count = 0;
+	parent_span = rndr->html_span;
+	rndr->html_span = &span;
+
+	while (beg < stop && !rndr->status) {
+		txt_data = data + beg;
+		end = size - beg;
+
+		mark.beg = beg;
+		mark.out = ob->size;
+		if (marks)
+			rndr->html_reach = 0;
+
+		if (cached)
+			hit = cache_block_get(ob, rndr, data, size, beg);
+
+		if (hit)
+			beg += hit;
+
+		else if (line_plain(rndr, txt_data, end))
+			beg += STAT_BLOCK(rndr, MKDS_PARAGRAPH,
+				parse_paragraph(ob, rndr, txt_data, end));
+
+		else if (is_atxheader(rndr, txt_data, end))
+			beg += STAT_BLOCK(rndr, MKDS_ATXHEADER,
+				parse_atxheader(ob, rndr, txt_data, end));
+
+		else if (data[beg] == '<' && rndr->cfg->cb.blockhtml &&
+				(i = STAT_BLOCK(rndr, MKDS_HTMLBLOCK,
+					parse_htmlblock(ob, rndr, txt_data, end, 1))) != 0)
+			beg += i;
+
+		else if ((i = line_empty(rndr, txt_data, end)) != 0)
+			beg += i;
+
+		else if (is_hrule(txt_data, end)) {
+			block_text(ob, rndr, MKDN_HRULE, NULL, NULL);
+			i = beg;
+
+			while (beg < size && data[beg] != '\n')
+				beg++;
+
+			beg++;
+			(void)STAT_BLOCK(rndr, MKDS_HRULE, beg - i);
+		}
+
+		else if ((rndr->cfg->ext_flags & MKDEXT_FENCED_CODE) != 0 &&
+			(i = STAT_BLOCK(rndr, MKDS_FENCEDCODE,
+				parse_fencedcode(ob, rndr, txt_data, end))) != 0)
+			beg += i;
+
+		else if ((rndr->cfg->ext_flags & MKDEXT_TABLES) != 0 &&
+			(i = STAT_BLOCK(rndr, MKDS_TABLE,
+				parse_table(ob, rndr, txt_data, end))) != 0)
 			beg += i;
 
 		else if (prefix_quote(txt_data, end))
-			beg += parse_blockquote(ob, rndr, txt_data, end);
+			beg += STAT_BLOCK(rndr, MKDS_BLOCKQUOTE,
+				parse_blockquote(ob, rndr, txt_data, end));
 
 		else if (prefix_code(txt_data, end))
-			beg += parse_blockcode(ob, rndr, txt_data, end);
+			beg += STAT_BLOCK(rndr, MKDS_BLOCKCODE,
+				parse_blockcode(ob, rndr, txt_data, end));
 
 		else if (prefix_uli(txt_data, end))
-			beg += parse_list(ob, rndr, txt_data, end, 0);
+			beg += STAT_BLOCK(rndr, MKDS_LIST,
+				parse_list(ob, rndr, txt_data, end, 0));
 
 		else if (prefix_oli(txt_data, end))
-			beg += parse_list(ob, rndr, txt_data, end, MKD_LIST_ORDERED);
+			beg += STAT_BLOCK(rndr, MKDS_LIST,
+				parse_list(ob, rndr, txt_data, end, MKD_LIST_ORDERED));
 
 		else
-			beg += parse_paragraph(ob, rndr, txt_data, end);
+			beg += STAT_BLOCK(rndr, MKDS_PARAGRAPH,
+				parse_paragraph(ob, rndr, txt_data, end));
+
+		if (marks) {
+			mark.reach = rndr->html_reach;
+			bufput(marks, &mark, sizeof(mark));
+		}
+
+		if (cached)
+			cache_block_put(ob, rndr, data, size, mark.beg, beg, mark.out);
+
+		/* top-level block done: streamed renders can let it go */
+		if (rndr->sink && ob->size >= SINK_UNIT &&
+			rndr->work_bufs[BUFFER_SPAN].size +
+			rndr->work_bufs[BUFFER_BLOCK].size == 0)
+			rndr_flush(ob, rndr, 1);
 	}
+
+	rndr->html_span = parent_span;
+	rndr->in_place = in_place;
+	return beg;
+}
+
+/* parse_block • parsing of a whole run of blocks */
+static void
+parse_block(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t size)
+{
+	parse_block_range(ob, rndr, data, size, 0, size, NULL);
 }
 
 
@@ -2252,7 +3555,8 @@ parse_block(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t size
 
 /* is_ref • returns whether a line is a reference or not */
 static int
-is_ref(const uint8_t *data, size_t beg, size_t end, size_t *last, struct link_ref **refs)
+is_ref(const uint8_t *data, size_t beg, size_t end, size_t *last, struct link_ref **refs,
+	const struct buf_allocator *alloc)
 {
 /*	int n; */
 	size_t i = 0;
@@ -2348,22 +3652,34 @@ is_ref(const uint8_t *data, size_t beg, size_t end, size_t *last, struct link_re
 	if (refs) {
 		struct link_ref *ref;
 
-		ref = add_link_ref(refs, data + id_offset, id_end - id_offset);
+		ref = add_link_ref(refs, alloc, data + id_offset, id_end - id_offset);
 		if (!ref)
 			return 0;
 
-		ref->link = bufnew(link_end - link_offset);
-		bufput(ref->link, data + link_offset, link_end - link_offset);
+		ref->link = bufnew_with(link_end - link_offset, alloc);
+		if (ref->link)
+			bufput(ref->link, data + link_offset, link_end - link_offset);
 
 		if (title_end > title_offset) {
-			ref->title = bufnew(title_end - title_offset);
-			bufput(ref->title, data + title_offset, title_end - title_offset);
+			ref->title = bufnew_with(title_end - title_offset, alloc);
+			if (ref->title)
+				bufput(ref->title, data + title_offset, title_end - title_offset);
 		}
 	}
 
 	return 1;
 }
 
+/* is_normalized • whether the preprocessing pass would only drop refs */
+/*	i.e. LF line ends, no tabs and a final newline */
+static int
+is_normalized(const uint8_t *data, size_t size)
+{
+	return size > 0 && data[size - 1] == '\n' &&
+		memchr(data, '\t', size) == NULL &&
+		memchr(data, '\r', size) == NULL;
+}
+
 static void expand_tabs(struct buf *ob, const uint8_t *line, size_t size)
 {
 	size_t  i = 0, tab = 0;
@@ -2389,159 +3705,1519 @@ static void expand_tabs(struct buf *ob, const uint8_t *line, size_t size)
 	}
 }
 
-/**********************
- * EXPORTED FUNCTIONS *
- **********************/
+/* text_step: where a line of the source starts, and where its copy does */
+/*	references copy to nothing, and their last '\n' makes a step of its own */
+struct text_step {
+	size_t src;
+	size_t text;
+};
 
-struct sd_markdown *
-sd_markdown_new(
-	unsigned int extensions,
-	size_t max_nesting,
-	const struct sd_callbacks *callbacks,
-	void *opaque)
+/* copy_line • first pass over the line, or the reference, at beg */
+/*	returns where the next one starts: the line is copied along with
+ *	the line ends after it, each of them turned into a single '\n' */
+static size_t
+copy_line(struct sd_markdown *md, struct buf *text, const uint8_t *document, size_t beg, size_t doc_size)
 {
-	struct sd_markdown *md = NULL;
+	size_t end, line_beg = text->size;
 
-	assert(max_nesting > 0 && callbacks);
+	if (is_ref(document, beg, doc_size, &end, &md->ref_list, md->alloc))
+		return end;
 
-	md = malloc(sizeof(struct sd_markdown));
-	if (!md)
-		return NULL;
+	end = beg;
+	while (end < doc_size && document[end] != '\n' && document[end] != '\r')
+		end++;
 
-	memcpy(&md->cb, callbacks, sizeof(struct sd_callbacks));
+	/* adding the line body if present */
+	if (end > beg)
+		expand_tabs(text, document + beg, end - beg);
 
-	stack_init(&md->work_bufs[BUFFER_BLOCK], 4);
-	stack_init(&md->work_bufs[BUFFER_SPAN], 8);
+	while (end < doc_size && (document[end] == '\n' || document[end] == '\r')) {
+		/* add one \n per newline */
+		if (document[end] == '\n' || (end + 1 < doc_size && document[end + 1] != '\n')) {
+			bufputc(text, '\n');
+			add_line(md, text->data + line_beg, text->size - line_beg, text->size);
+			line_beg = text->size;
+		}
+		end++;
+	}
 
-	memset(md->active_char, 0x0, 256);
+	return end;
+}
 
-	if (md->cb.emphasis || md->cb.double_emphasis || md->cb.triple_emphasis) {
-		md->active_char['*'] = MD_CHAR_EMPHASIS;
-		md->active_char['_'] = MD_CHAR_EMPHASIS;
-		if (extensions & MKDEXT_STRIKETHROUGH)
-			md->active_char['~'] = MD_CHAR_EMPHASIS;
+/* copy_text • first pass over a document that is not normalized */
+/*	the references are taken out, tabs expanded and every line end
+ *	turned into a single '\n', the last line included; steps, when
+ *	given, gets a text_step for each line */
+static void
+copy_text(struct sd_markdown *md, struct buf *text, const uint8_t *document, size_t beg,
+	size_t doc_size, struct buf *steps)
+{
+	struct text_step step;
+	size_t line_beg = text->size;
+
+	while (beg < doc_size) {
+		if (steps) {
+			step.src = beg;
+			step.text = text->size;
+			bufput(steps, &step, sizeof(step));
+		}
+
+		line_beg = text->size;
+		beg = copy_line(md, text, document, beg, doc_size);
 	}
 
-	if (md->cb.codespan)
-		md->active_char['`'] = MD_CHAR_CODESPAN;
+	/* adding a final newline if not already present */
+	if (text->size && text->data[text->size - 1] != '\n') {
+		bufputc(text, '\n');
+		add_line(md, text->data + line_beg, text->size - line_beg, text->size);
+	}
+}
 
-	if (md->cb.linebreak)
-		md->active_char['\n'] = MD_CHAR_LINEBREAK;
+/* doc_header • the document header, or the enter event of the document */
+/*	partial renders leave the document alone, so its node carries no
+ *	offsets */
+static void
+doc_header(struct buf *ob, struct sd_markdown *md)
+{
+	struct sd_node node;
 
-	if (md->cb.image || md->cb.link)
-		md->active_char['['] = MD_CHAR_LINK;
+	if (md->cfg->events.enter) {
+		node_init(&node, MKDN_DOCUMENT);
+		md->cfg->events.enter(ob, &node, md->opaque);
+	}
+	else if (md->cfg->cb.doc_header)
+		md->cfg->cb.doc_header(ob, md->opaque);
+}
 
-	md->active_char['<'] = MD_CHAR_LANGLE;
-	md->active_char['\\'] = MD_CHAR_ESCAPE;
-	md->active_char['&'] = MD_CHAR_ENTITITY;
+/* doc_footer • the document footer, or the leave event of the document */
+static void
+doc_footer(struct buf *ob, struct sd_markdown *md)
+{
+	struct sd_node node;
 
-	if (extensions & MKDEXT_AUTOLINK) {
-		md->active_char[':'] = MD_CHAR_AUTOLINK_URL;
-		md->active_char['@'] = MD_CHAR_AUTOLINK_EMAIL;
-		md->active_char['w'] = MD_CHAR_AUTOLINK_WWW;
+	if (md->cfg->events.enter) {
+		node_init(&node, MKDN_DOCUMENT);
+		md->cfg->events.leave(ob, &node, md->opaque);
 	}
+	else if (md->cfg->cb.doc_footer)
+		md->cfg->cb.doc_footer(ob, md->opaque);
+}
 
-	if (extensions & MKDEXT_SUPERSCRIPT)
-		md->active_char['^'] = MD_CHAR_SUPERSCRIPT;
+/* context_init • fresh per-render state over a config */
+static int
+context_init(struct sd_markdown *md, const struct sd_config *cfg, void *opaque)
+{
+	if (stack_init(&md->work_bufs[BUFFER_BLOCK], 4) < 0)
+		return -1;
 
-	/* Extension data */
-	md->ext_flags = extensions;
+	if (stack_init(&md->work_bufs[BUFFER_SPAN], 8) < 0) {
+		stack_free(&md->work_bufs[BUFFER_BLOCK]);
+		return -1;
+	}
+
+	md->cfg = cfg;
+	md->own_cfg = NULL;
 	md->opaque = opaque;
-	md->max_nesting = max_nesting;
+	md->ref_list = NULL;
+	md->refs = NULL;
+	md->refs_size = 0;
 	md->in_link_body = 0;
+	md->node_base = 0;
+	md->emph_span = NULL;
+	md->html_span = NULL;
+	md->html_reach = 0;
+	md->line_work = NULL;
+	md->line_stop = 0;
+	md->lines = NULL;
+	md->line_count = 0;
+	md->line_data = NULL;
+	md->line_size = 0;
+	md->line_cur = 0;
+	md->threads = 1;
+#ifdef SUNDOWN_STATS
+	md->stats = NULL;
+#endif
+	md->cache = NULL;
+	md->cache_settings = 0;
+	md->cache_hash = 0;
+	md->cache_block = 0;
+	md->cache_refs = NULL;
+	md->cache_key = NULL;
+	md->sink = NULL;
+	md->sink_opaque = NULL;
+	md->in_place = 0;
+	md->quote_work = NULL;
+	md->text_work = NULL;
+	md->arena.head = md->arena.cur = NULL;
+
+	mem_tracker_init(&md->mem_work, md, NULL);
+	mem_tracker_init(&md->mem_out, md, NULL);
+	md->alloc = &md->mem_work.hooks;
+	md->mem_used = md->mem_peak = md->mem_limit = 0;
+	md->status = MKD_OK;
+	return 0;
+}
 
-	return md;
+/**********************
+ * PARALLEL RENDERING *
+ **********************/
+
+/* block_chunk: slice of the top-level blocks handed to a worker */
+struct block_chunk {
+	size_t beg, end;	/* where the text was cut */
+	size_t stop;	/* where the last block of the slice really ends */
+	int seed;	/* output byte the slice was rendered after, or -1 */
+	int status;
+	struct buf *ob;
+	struct buf *marks;	/* block_mark of every block in ob */
+};
+
+/* block_split: one render spread over the worker pool */
+struct block_split {
+	struct sd_markdown *workers;	/* one context per thread */
+	struct block_chunk *chunks;
+	uint8_t *data;
+	size_t size;
+};
+
+static void release_work_bufs(struct sd_markdown *md);
+
+/* next_block_start • first unindented line of text after a blank one */
+/*	only a guess: a fence or a HTML block may still run across it */
+static size_t
+next_block_start(const uint8_t *data, size_t size, size_t from)
+{
+	const uint8_t *eol;
+
+	while (from + 2 < size &&
+		(eol = memchr(data + from, '\n', size - from - 2)) != NULL) {
+		from = (size_t)(eol - data) + 1;
+
+		if (data[from] == '\n' && isalpha(data[from + 1]))
+			return from + 1;
+	}
+
+	return size;
 }
 
-void
-sd_markdown_render(struct buf *ob, const uint8_t *document, size_t doc_size, struct sd_markdown *md)
+/* worker_init • context sharing the references and lines of md */
+/*	everything the parsers write to is the worker's own */
+static int
+worker_init(struct sd_markdown *w, const struct sd_markdown *md)
 {
-#define MARKDOWN_GROW(x) ((x) + ((x) >> 1))
-	static const char UTF8_BOM[] = {0xEF, 0xBB, 0xBF};
+	if (context_init(w, md->cfg, md->opaque) < 0)
+		return -1;
+
+	w->ref_list = md->ref_list;
+	w->refs = md->refs;
+	w->refs_size = md->refs_size;
+	w->lines = md->lines;
+	w->line_count = md->line_count;
+	w->line_data = md->line_data;
+	w->line_size = md->line_size;
+	w->line_stop = 1;
+	w->in_place = md->in_place;
+	w->mem_limit = md->mem_limit;
+	return 0;
+}
 
-	struct buf *text;
-	size_t beg, end;
+static void
+worker_free(struct sd_markdown *w)
+{
+	release_work_bufs(w);
+	stack_free(&w->work_bufs[BUFFER_SPAN]);
+	stack_free(&w->work_bufs[BUFFER_BLOCK]);
+}
 
-	text = bufnew(64);
-	if (!text)
+/* render_chunk • pool task rendering one slice on its own */
+static void
+render_chunk(void *opaque, size_t index, unsigned int worker)
+{
+	struct block_split *split = opaque;
+	struct block_chunk *chunk = &split->chunks[index];
+	struct sd_markdown *w = &split->workers[worker];
+	size_t size = chunk->end - chunk->beg;
+
+	w->status = MKD_OK;
+	w->line_cur = w->line_count;	/* far from the last slice */
+
+	chunk->ob = bufnew_with(size + (size >> 1) + 1, w->alloc);
+	chunk->marks = bufnew_with(64 * sizeof(struct block_mark), w->alloc);
+	if (!chunk->ob || !chunk->marks) {
+		chunk->status = MKD_ENOMEM;
 		return;
+	}
 
-	/* Preallocate enough space for our buffer to avoid expanding while copying */
-	bufgrow(text, doc_size);
+	/* renderers peek at the last byte of the output */
+	if (chunk->seed >= 0)
+		bufputc(chunk->ob, (uint8_t)chunk->seed);
 
-	/* reset the references table */
-	memset(&md->refs, 0x0, REF_TABLE_SIZE * sizeof(void *));
+	chunk->stop = parse_block_range(chunk->ob, w, split->data, split->size,
+		chunk->beg, chunk->end, chunk->marks);
+	chunk->status = w->status;
+}
 
-	/* first pass: looking for references, copying everything else */
-	beg = 0;
+/* chunk_mark • block of a slice starting at pos, after the same output */
+/*	from there on, the slice holds what a serial render would give */
+static const struct block_mark *
+chunk_mark(const struct block_chunk *chunk, size_t pos, const struct buf *ob)
+{
+	const struct block_mark *marks;
+	size_t lo = 0, hi, mid;
 
-	/* Skip a possible UTF-8 BOM, even though the Unicode standard
-	 * discourages having these in UTF-8 documents */
-	if (doc_size >= 3 && memcmp(document, UTF8_BOM, 3) == 0)
-		beg += 3;
+	if (chunk->status != MKD_OK)
+		return NULL;
 
-	while (beg < doc_size) /* iterating over lines */
-		if (is_ref(document, beg, doc_size, &end, md->refs))
-			beg = end;
-		else { /* skipping to the next line */
-			end = beg;
-			while (end < doc_size && document[end] != '\n' && document[end] != '\r')
-				end++;
-
-			/* adding the line body if present */
-			if (end > beg)
-				expand_tabs(text, document + beg, end - beg);
-
-			while (end < doc_size && (document[end] == '\n' || document[end] == '\r')) {
-				/* add one \n per newline */
-				if (document[end] == '\n' || (end + 1 < doc_size && document[end + 1] != '\n'))
-					bufputc(text, '\n');
-				end++;
+	marks = (const struct block_mark *)chunk->marks->data;
+	hi = chunk->marks->size / sizeof(struct block_mark);
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (marks[mid].beg < pos)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (lo * sizeof(struct block_mark) == chunk->marks->size || marks[lo].beg != pos)
+		return NULL;
+
+	/* renderers peek at the last byte of the output */
+	if (marks[lo].out == 0)
+		return ob->size == 0 ? &marks[lo] : NULL;
+
+	if (ob->size == 0 || ob->data[ob->size - 1] != chunk->ob->data[marks[lo].out - 1])
+		return NULL;
+
+	return &marks[lo];
+}
+
+/* parse_parallel • renders the top-level blocks on the worker pool */
+/*	slices are cut where a block probably starts, and rendered as if
+ *	they followed a block; joining them in order checks both guesses.
+ *	A wrong cut is rendered again in place, one block at a time until
+ *	a block of the slice starts at the same spot */
+static int
+parse_parallel(struct buf *ob, struct sd_markdown *md, uint8_t *data, size_t size)
+{
+	struct block_split split;
+	size_t count, step, i, beg, pos, ob_size = ob->size;
+	unsigned int threads = md->threads, started = 0;
+	int done = -1, in_place = md->in_place;
+
+	count = (size_t)threads * SPLIT_CHUNKS;
+	if (count > size / SPLIT_MIN_CHUNK)
+		count = size / SPLIT_MIN_CHUNK;
+
+	if (count < 2)
+		return -1;
+
+	/* blockquotes must not compact a text the other threads read */
+	md->in_place = 1;
+
+	split.data = data;
+	split.size = size;
+	split.chunks = calloc(count, sizeof(struct block_chunk));
+	split.workers = malloc(threads * sizeof(struct sd_markdown));
+
+	if (!split.chunks || !split.workers)
+		goto fail;
+
+	for (; started < threads; ++started)
+		if (worker_init(&split.workers[started], md) < 0)
+			goto fail;
+
+	/* cutting the text into slices of about the same size */
+	step = size / count;
+	for (i = 0, beg = 0; i < count && beg < size; ++i) {
+		struct block_chunk *chunk = &split.chunks[i];
+
+		chunk->beg = beg;
+		chunk->end = (i + 1 < count) ? next_block_start(data, size, beg + step) : size;
+		chunk->seed = '\n';
+		beg = chunk->end;
+	}
+
+	count = i;
+	split.chunks[0].seed = ob->size ? ob->data[ob->size - 1] : -1;
+
+	pool_run(threads, count, render_chunk, &split);
+
+	/* joining the slices, in document order */
+	for (i = 0, pos = 0; i < count && !md->status; ++i) {
+		struct block_chunk *chunk = &split.chunks[i];
+		size_t steps = 0;
+
+		/* slices already covered by a block that ran past the cut
+		 * are skipped over */
+		while (pos < chunk->end && !md->status) {
+			const struct block_mark *mark = chunk_mark(chunk, pos, ob);
+
+			if (mark) {
+				bufput(ob, chunk->ob->data + mark->out, chunk->ob->size - mark->out);
+				pos = chunk->stop;
+				break;
 			}
 
-			beg = end;
+			md->line_cur = md->line_count;
+			pos = parse_block_range(ob, md, data, size, pos,
+				steps++ < SPLIT_RESYNC ? pos + 1 : chunk->end, NULL);
 		}
+	}
+
+	/* after a failure, a serial render decides where the output stops */
+	if (md->status) {
+		md->status = MKD_OK;
+		ob->size = ob_size;
+		md->line_cur = 0;
+		parse_block(ob, md, data, size);
+	}
 
-	/* pre-grow the output buffer to minimize allocations */
-	bufgrow(ob, MARKDOWN_GROW(text->size));
+	for (i = 0; i < count; ++i) {
+		bufrelease(split.chunks[i].ob);
+		bufrelease(split.chunks[i].marks);
+	}
 
-	/* second pass: actual rendering */
-	if (md->cb.doc_header)
-		md->cb.doc_header(ob, md->opaque);
+	done = 0;
 
-	if (text->size) {
-		/* adding a final newline if not already present */
-		if (text->data[text->size - 1] != '\n' &&  text->data[text->size - 1] != '\r')
-			bufputc(text, '\n');
+fail:
+	while (started)
+		worker_free(&split.workers[--started]);
 
-		parse_block(ob, md, text->data, text->size);
-	}
+	free(split.workers);
+	free(split.chunks);
+	md->in_place = in_place;
+	return done;
+}
+
+/* render_blocks • second pass over the whole text */
+static void
+render_blocks(struct buf *ob, struct sd_markdown *md, uint8_t *data, size_t size)
+{
+	/* streamed output goes out block by block, in order */
+	if (md->threads > 1 && !md->sink && !md->status &&
+		size >= 2 * SPLIT_MIN_CHUNK &&
+		parse_parallel(ob, md, data, size) == 0)
+		return;
 
-	if (md->cb.doc_footer)
-		md->cb.doc_footer(ob, md->opaque);
+	parse_block(ob, md, data, size);
+}
 
-	/* clean-up */
-	bufrelease(text);
-	free_link_refs(md->refs);
+/*************************
+ * INCREMENTAL RENDERING *
+ *************************/
+
+/* sd_document: a text kept rendered from one edit to the next */
+struct sd_document {
+	struct sd_markdown *md;
+	struct buf *source;	/* the document as last given */
+	struct buf *text;	/* its first pass copy, lines in md->line_work */
+	struct buf *steps;	/* text_step of every line of source */
+	struct buf *next;	/* first pass copy of the lines copied again */
+	struct buf *next_steps;	/* their text_step */
+	struct buf *next_lines;	/* their line_info */
+	struct buf *html;	/* whole output, footer included */
+	struct buf *blocks;	/* block_mark of every top-level block of text */
+	struct buf *fresh;	/* block_mark of the blocks rendered again */
+	struct buf *work;	/* their output */
+	size_t skip;	/* UTF-8 BOM left out of the text */
+	size_t foot;	/* where the footer starts in html */
+	int valid;	/* everything above matches source */
+};
 
-	assert(md->work_bufs[BUFFER_SPAN].size == 0);
-	assert(md->work_bufs[BUFFER_BLOCK].size == 0);
+/* buf_splice • replaces size bytes of ob at pos with data */
+static int
+buf_splice(struct buf *ob, size_t pos, size_t size, const void *data, size_t data_size)
+{
+	if (data_size > size && bufgrow(ob, ob->size - size + data_size) < 0)
+		return -1;
+
+	if (ob->size > pos + size)
+		memmove(ob->data + pos + data_size, ob->data + pos + size, ob->size - pos - size);
+
+	if (data_size)
+		memcpy(ob->data + pos, data, data_size);
+
+	ob->size = ob->size - size + data_size;
+	return 0;
 }
 
-void
-sd_markdown_free(struct sd_markdown *md)
+/* common_prefix • how many bytes a and b start with in common */
+static size_t
+common_prefix(const uint8_t *a, const uint8_t *b, size_t size)
 {
-	size_t i;
+	size_t i = 0;
+
+	while (i + 64 <= size && memcmp(a + i, b + i, 64) == 0)
+		i += 64;
+
+	while (i < size && a[i] == b[i])
+		i++;
+
+	return i;
+}
 
-	for (i = 0; i < (size_t)md->work_bufs[BUFFER_SPAN].asize; ++i)
-		bufrelease(md->work_bufs[BUFFER_SPAN].item[i]);
+/* common_suffix • how many bytes a and b end with in common, up to max */
+static size_t
+common_suffix(const uint8_t *a, size_t a_size, const uint8_t *b, size_t b_size, size_t max)
+{
+	size_t i = 0;
+
+	while (i + 64 <= max && memcmp(a + a_size - i - 64, b + b_size - i - 64, 64) == 0)
+		i += 64;
+
+	while (i < max && a[a_size - i - 1] == b[b_size - i - 1])
+		i++;
+
+	return i;
+}
+
+/* ref_buf_eq • same link or title, both possibly missing */
+static int
+ref_buf_eq(const struct buf *a, const struct buf *b)
+{
+	if (!a || !b)
+		return a == b;
+
+	return a->size == b->size && memcmp(a->data, b->data, a->size) == 0;
+}
+
+/* link_refs_eq • whether two reference lists define the same links */
+static int
+link_refs_eq(const struct link_ref *a, const struct link_ref *b)
+{
+	for (; a && b; a = a->next, b = b->next)
+		if (a->name_size != b->name_size ||
+			memcmp(a->name, b->name, a->name_size) != 0 ||
+			!ref_buf_eq(a->link, b->link) || !ref_buf_eq(a->title, b->title))
+			return 0;
+
+	return a == b;
+}
+
+/* document_copy • first pass over the whole source */
+/*	returns whether the references are the same as before; pre and suf
+ *	get the length of the text left as it was at both ends */
+static int
+document_copy(struct sd_document *doc, size_t *pre, size_t *suf)
+{
+	struct sd_markdown *md = doc->md;
+	struct link_ref *ref_list = md->ref_list;
+	struct buf *swap;
+	size_t size;
+	int same;
+
+	md->ref_list = NULL;
+	reset_lines(md);
+
+	doc->next->size = 0;
+	doc->next_steps->size = 0;
+	bufgrow(doc->next, doc->source->size);
+	copy_text(md, doc->next, doc->source->data, doc->skip, doc->source->size, doc->next_steps);
+
+	/* the references go on, unless any of them changed */
+	same = link_refs_eq(md->ref_list, ref_list);
+
+	if (same) {
+		free_ref_list(md, md->ref_list);
+		md->ref_list = ref_list;
+	} else {
+		free_ref_list(md, ref_list);
+		bufmem_free(md->alloc, md->refs, md->refs_size * sizeof(struct link_ref *));
+		md->refs = NULL;
+		md->refs_size = 0;
+		index_link_refs(md);
+	}
+
+	size = doc->text->size < doc->next->size ? doc->text->size : doc->next->size;
+	*pre = common_prefix(doc->text->data, doc->next->data, size);
+	*suf = common_suffix(doc->text->data, doc->text->size,
+		doc->next->data, doc->next->size, size - *pre);
+
+	swap = doc->text;
+	doc->text = doc->next;
+	doc->next = swap;
+
+	swap = doc->steps;
+	doc->steps = doc->next_steps;
+	doc->next_steps = swap;
 
-	for (i = 0; i < (size_t)md->work_bufs[BUFFER_BLOCK].asize; ++i)
-		bufrelease(md->work_bufs[BUFFER_BLOCK].item[i]);
+	return same;
+}
+
+/* document_recopy • first pass over the source lines an edit touched */
+/*	from three lines before the edit, as a reference looks at the byte
+ *	past the line of its title, until a line starts where one did in
+ *	the old source. The copy and its line table entries are spliced into
+ *	the old ones; returns -1, leaving everything as it was, when a
+ *	reference gets in the way */
+static int
+document_recopy(struct sd_document *doc, size_t pos, size_t src_suf, size_t old_src_size,
+	size_t *pre, size_t *suf)
+{
+	struct sd_markdown *md = doc->md;
+	struct buf *next = doc->next, *line_work = md->line_work;
+	const uint8_t *src = doc->source->data;
+	size_t src_size = doc->source->size;
+	struct text_step *steps = (struct text_step *)doc->steps->data, step, *st;
+	size_t count = doc->steps->size / sizeof(struct text_step);
+	struct link_ref *ref_list = md->ref_list, *new_refs;
+	struct line_info *lines, *ln;
+	size_t line_count, lo, hi, mid, a, k, i, beg, at, t0, t1, l0, l1, line_beg = 0;
+
+	if (count == 0 || !line_work || md->line_stop)
+		return -1;
+
+	lo = 0;
+	hi = count;
+	while (hi - lo > 1) {
+		mid = lo + (hi - lo) / 2;
+		if (steps[mid].src <= pos)
+			lo = mid;
+		else
+			hi = mid;
+	}
+
+	a = lo > 3 ? lo - 3 : 0;
+	beg = steps[a].src;
+	t0 = steps[a].text;
+	k = count;
+
+	next->size = 0;
+	doc->next_steps->size = 0;
+	doc->next_lines->size = 0;
+	md->line_work = doc->next_lines;
+	md->ref_list = NULL;
+
+	while (beg < src_size && !md->ref_list) {
+		step.src = beg;
+		step.text = next->size;
+		bufput(doc->next_steps, &step, sizeof(step));
+
+		line_beg = next->size;
+		beg = copy_line(md, next, src, beg, src_size);
+
+		if (beg < src_size - src_suf)
+			continue;
+
+		/* a line of the old source starting at the same spot */
+		at = beg + old_src_size - src_size;
+		lo = a + 1;
+		hi = count;
+		while (lo < hi) {
+			mid = lo + (hi - lo) / 2;
+			if (steps[mid].src < at)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+
+		if (lo < count && steps[lo].src == at) {
+			k = lo;
+			break;
+		}
+	}
+
+	/* adding a final newline if not already present */
+	if (k == count && next->size && next->data[next->size - 1] != '\n') {
+		bufputc(next, '\n');
+		add_line(md, next->data + line_beg, next->size - line_beg, next->size);
+	}
+
+	md->line_work = line_work;
+	new_refs = md->ref_list;
+	md->ref_list = ref_list;
+
+	if (new_refs) {
+		free_ref_list(md, new_refs);
+		return -1;
+	}
+
+	if (md->line_stop || md->status)
+		return -1;
+
+	/* old lines copying to nothing were references */
+	for (i = a; i < k; ++i)
+		if ((i + 1 < count ? steps[i + 1].text : doc->text->size) == steps[i].text)
+			return -1;
+
+	t1 = k < count ? steps[k].text : doc->text->size;
+
+	lines = (struct line_info *)line_work->data;
+	line_count = line_work->size / sizeof(struct line_info);
+
+	for (l0 = 0, hi = line_count; l0 < hi; ) {
+		mid = l0 + (hi - l0) / 2;
+		if (lines[mid].end <= t0)
+			l0 = mid + 1;
+		else
+			hi = mid;
+	}
+
+	for (l1 = l0, hi = line_count; l1 < hi; ) {
+		mid = l1 + (hi - l1) / 2;
+		if (lines[mid].end <= t1)
+			l1 = mid + 1;
+		else
+			hi = mid;
+	}
+
+	/* everything copied again moves to its place in the text... */
+	for (st = (struct text_step *)doc->next_steps->data;
+		(uint8_t *)st < doc->next_steps->data + doc->next_steps->size; ++st)
+		st->text += t0;
+
+	for (ln = (struct line_info *)doc->next_lines->data;
+		(uint8_t *)ln < doc->next_lines->data + doc->next_lines->size; ++ln)
+		ln->end += t0;
+
+	/* ...and everything after it moves along */
+	for (i = k; i < count; ++i) {
+		steps[i].src = steps[i].src + src_size - old_src_size;
+		steps[i].text = steps[i].text - t1 + t0 + next->size;
+	}
+
+	for (i = l1; i < line_count; ++i)
+		lines[i].end = lines[i].end - t1 + t0 + next->size;
+
+	*pre = t0;
+	*suf = doc->text->size - t1;
+
+	if (buf_splice(doc->text, t0, t1 - t0, next->data, next->size) < 0 ||
+		buf_splice(doc->steps, a * sizeof(struct text_step), (k - a) * sizeof(struct text_step),
+			doc->next_steps->data, doc->next_steps->size) < 0 ||
+		buf_splice(line_work, l0 * sizeof(struct line_info), (l1 - l0) * sizeof(struct line_info),
+			doc->next_lines->data, doc->next_lines->size) < 0)
+		md->status = MKD_ENOMEM;
+
+	return 0;
+}
+
+/* document_full • renders the whole text again */
+static void
+document_full(struct sd_document *doc)
+{
+	struct sd_markdown *md = doc->md;
+	struct buf *text = doc->text;
+
+	doc->html->size = 0;
+	doc->blocks->size = 0;
+
+	doc_header(doc->html, md);
+
+	parse_block_range(doc->html, md, text->data, text->size, 0, text->size, doc->blocks);
+	doc->foot = doc->html->size;
+
+	doc_footer(doc->html, md);
+}
+
+/* document_partial • renders again the blocks an edit may have changed */
+/*	The text only changed past its first pre bytes and before its last
+ *	suf ones, out of old_size. Parsing starts over from the first block
+ *	whose parse could have seen a changed byte, one block at a time until
+ *	a block starts where one did in the old text, after the same output
+ *	byte: everything after it is the same text, parsed the same way */
+static void
+document_partial(struct sd_document *doc, size_t pre, size_t suf, size_t old_size)
+{
+	struct sd_markdown *md = doc->md;
+	struct buf *text = doc->text;
+	struct block_mark *marks = (struct block_mark *)doc->blocks->data, *m;
+	size_t count = doc->blocks->size / sizeof(struct block_mark);
+	size_t lo, hi, mid, s, k, j, pos, at, out, end, seed;
+	int last;
+
+	if (count == 0) {
+		document_full(doc);
+		return;
+	}
+
+	/* last block starting before the change; the text before it is
+	 * the same, so is what the parsers saw of it */
+	lo = 0;
+	hi = count;
+	while (hi - lo > 1) {
+		mid = lo + (hi - lo) / 2;
+		if (marks[mid].beg <= pre)
+			lo = mid;
+		else
+			hi = mid;
+	}
+
+	for (s = lo; s > 0 && block_reach(text->data, text->size, marks[s].beg) >= pre; s--)
+		/* empty */;
+
+	/* HTML block searches may have looked much further, up to the
+	 * end of the text when they failed */
+	for (j = 0; j < s; ++j)
+		if (marks[j].reach && block_reach(text->data, text->size, marks[j].reach) >= pre) {
+			s = j;
+			break;
+		}
+
+	/* renderers peek at the last byte of the output */
+	doc->work->size = 0;
+	doc->fresh->size = 0;
+	out = marks[s].out;
+	if (out)
+		bufputc(doc->work, doc->html->data[out - 1]);
+
+	seed = doc->work->size;
+	pos = marks[s].beg;
+	k = count;
+
+	while (pos < text->size && !md->status) {
+		pos = parse_block_range(doc->work, md, text->data, text->size, pos, pos + 1, doc->fresh);
+
+		if (pos >= text->size || pos < text->size - suf)
+			continue;
+
+		/* a block of the old text starting at the same spot */
+		at = pos + old_size - text->size;
+		lo = s;
+		hi = count;
+		while (lo < hi) {
+			mid = lo + (hi - lo) / 2;
+			if (marks[mid].beg < at)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+
+		last = doc->work->size ? doc->work->data[doc->work->size - 1] : -1;
+		if (lo < count && marks[lo].beg == at &&
+			(marks[lo].out ? doc->html->data[marks[lo].out - 1] : -1) == last) {
+			k = lo;
+			break;
+		}
+	}
+
+	if (md->status)
+		return;
+
+	/* rendered to the end: the footer goes again */
+	if (k == count) {
+		end = doc->html->size;
+		doc->foot = out + doc->work->size - seed;
+
+		doc_footer(doc->work, md);
+	} else {
+		end = marks[k].out;
+		doc->foot = doc->foot - end + out + doc->work->size - seed;
+	}
+
+	/* blocks rendered again get their place in the whole output... */
+	for (m = (struct block_mark *)doc->fresh->data;
+		(uint8_t *)m < doc->fresh->data + doc->fresh->size; ++m)
+		m->out = m->out - seed + out;
+
+	/* ...and the ones after them move along */
+	for (j = k; j < count; ++j) {
+		marks[j].beg = marks[j].beg + text->size - old_size;
+		marks[j].out = marks[j].out - end + out + doc->work->size - seed;
+		if (marks[j].reach)
+			marks[j].reach = marks[j].reach + text->size - old_size;
+	}
+
+	if (buf_splice(doc->html, out, end - out, doc->work->data + seed, doc->work->size - seed) < 0 ||
+		buf_splice(doc->blocks, s * sizeof(struct block_mark), (k - s) * sizeof(struct block_mark),
+			doc->fresh->data, doc->fresh->size) < 0)
+		md->status = MKD_ENOMEM;
+}
+
+/* document_refresh • brings the render up to date with an edit */
+/*	the source changed past its first pos bytes and before its last
+ *	src_suf ones, out of old_src_size */
+static int
+document_refresh(struct sd_document *doc, size_t pos, size_t src_suf, size_t old_src_size)
+{
+	static const char UTF8_BOM[] = {0xEF, 0xBB, 0xBF};
+
+	struct sd_markdown *md = doc->md;
+	size_t pre, suf, old_size = doc->text->size, skip = 0;
+	int same = 1;
+
+	md->status = MKD_OK;
+	md->mem_peak = md->mem_used;
+
+	if (doc->source->size >= 3 && memcmp(doc->source->data, UTF8_BOM, 3) == 0)
+		skip = 3;
+
+	/* the lines around the edit are copied again, unless a reference
+	 * might have changed */
+	if (!doc->valid || skip != doc->skip || pos < skip ||
+		document_recopy(doc, pos, src_suf, old_src_size, &pre, &suf) < 0) {
+		doc->skip = skip;
+		same = document_copy(doc, &pre, &suf);
+	}
+
+	/* the blocks get parsed in the copy, compacting nothing */
+	if (md->status == MKD_OK) {
+		index_lines(md, doc->text->data, doc->text->size);
+		md->in_place = 1;
+
+		if (same && doc->valid)
+			document_partial(doc, pre, suf, old_size);
+		else
+			document_full(doc);
+
+		md->in_place = 0;
+	}
+
+	doc->valid = (md->status == MKD_OK);
+
+	md->lines = NULL;
+	md->line_count = 0;
+	md->line_data = NULL;
+	md->line_size = 0;
+
+	assert(md->work_bufs[BUFFER_SPAN].size == 0);
+	assert(md->work_bufs[BUFFER_BLOCK].size == 0);
+
+	if (md->status != MKD_OK)
+		release_work_bufs(md);
+
+	return md->status;
+}
+
+/* event stubs • never called: event configs only test them for NULL */
+#define EVENT_SKIP(skip, type) (((skip) >> (type)) & 1)
+
+static void
+event_pair(struct buf *ob, const struct buf *a, const struct buf *b, void *opaque)
+{
+}
+
+static void
+event_text(struct buf *ob, const struct buf *text, void *opaque)
+{
+}
+
+static void
+event_flags(struct buf *ob, const struct buf *text, int flags, void *opaque)
+{
+}
+
+static void
+event_none(struct buf *ob, void *opaque)
+{
+}
+
+static int
+event_autolink(struct buf *ob, const struct buf *link, enum mkd_autolink type, void *opaque)
+{
+	return 0;
+}
+
+static int
+event_span(struct buf *ob, const struct buf *text, void *opaque)
+{
+	return 0;
+}
+
+static int
+event_link(struct buf *ob, const struct buf *link, const struct buf *title,
+	const struct buf *content, void *opaque)
+{
+	return 0;
+}
+
+static int
+event_linebreak(struct buf *ob, void *opaque)
+{
+	return 0;
+}
+
+/**********************
+ * EXPORTED FUNCTIONS *
+ **********************/
+
+struct sd_config *
+sd_config_new(
+	unsigned int extensions,
+	size_t max_nesting,
+	const struct sd_callbacks *callbacks)
+{
+	struct sd_config *cfg = NULL;
+	size_t i;
+
+	assert(max_nesting > 0 && callbacks);
+
+	cfg = malloc(sizeof(struct sd_config));
+	if (!cfg)
+		return NULL;
+
+	memcpy(&cfg->cb, callbacks, sizeof(struct sd_callbacks));
+	memset(cfg->active_char, 0x0, 256);
+
+	if (cfg->cb.emphasis || cfg->cb.double_emphasis || cfg->cb.triple_emphasis) {
+		cfg->active_char['*'] = MD_CHAR_EMPHASIS;
+		cfg->active_char['_'] = MD_CHAR_EMPHASIS;
+		if (extensions & MKDEXT_STRIKETHROUGH)
+			cfg->active_char['~'] = MD_CHAR_EMPHASIS;
+	}
+
+	if (cfg->cb.codespan)
+		cfg->active_char['`'] = MD_CHAR_CODESPAN;
+
+	if (cfg->cb.linebreak)
+		cfg->active_char['\n'] = MD_CHAR_LINEBREAK;
+
+	if (cfg->cb.image || cfg->cb.link)
+		cfg->active_char['['] = MD_CHAR_LINK;
+
+	cfg->active_char['<'] = MD_CHAR_LANGLE;
+	cfg->active_char['\\'] = MD_CHAR_ESCAPE;
+	cfg->active_char['&'] = MD_CHAR_ENTITITY;
+
+	if (extensions & MKDEXT_AUTOLINK) {
+		cfg->active_char[':'] = MD_CHAR_AUTOLINK_URL;
+		cfg->active_char['@'] = MD_CHAR_AUTOLINK_EMAIL;
+		cfg->active_char['w'] = MD_CHAR_AUTOLINK_WWW;
+	}
+
+	if (extensions & MKDEXT_SUPERSCRIPT)
+		cfg->active_char['^'] = MD_CHAR_SUPERSCRIPT;
+
+	/* lookup tables for the vector scanners: all the active chars
+	 * are ASCII, so a high nibble fits in one bit of a byte */
+	cfg->active_count = 0;
+	memset(cfg->active_lo, 0x0, 16);
+	memset(cfg->active_hi, 0x0, 16);
+
+	for (i = 0; i < 128; ++i) {
+		if (!cfg->active_char[i])
+			continue;
+
+		cfg->active_list[cfg->active_count++] = (uint8_t)i;
+		cfg->active_lo[i & 0xf] |= 1 << (i >> 4);
+		cfg->active_hi[i >> 4] = 1 << (i >> 4);
+	}
+
+	/* Extension data */
+	cfg->ext_flags = extensions;
+	cfg->max_nesting = max_nesting;
+
+	cfg->hash = bufhash(&cfg->cb, sizeof(struct sd_callbacks),
+		((uint64_t)max_nesting << 32) ^ extensions);
+
+	memset(&cfg->events, 0x0, sizeof(struct sd_events));
+	return cfg;
+}
+
+struct sd_config *
+sd_config_new_events(
+	unsigned int extensions,
+	size_t max_nesting,
+	const struct sd_events *events)
+{
+	struct sd_callbacks cb;
+	struct sd_config *cfg;
+	unsigned int skip;
+
+	assert(events && events->enter && events->leave);
+
+	/* the parser only asks the callbacks whether a construct is
+	 * rendered: stubs stand for every node that is not skipped */
+	skip = events->skip;
+	memset(&cb, 0x0, sizeof(struct sd_callbacks));
+
+	cb.blockcode = event_pair;
+	cb.blockquote = event_text;
+	cb.blockhtml = EVENT_SKIP(skip, MKDN_BLOCKHTML) ? NULL : event_text;
+	cb.header = event_flags;
+	cb.hrule = event_none;
+	cb.list = event_flags;
+	cb.listitem = event_flags;
+	cb.paragraph = event_text;
+	cb.table = event_pair;
+	cb.table_row = event_text;
+	cb.table_cell = event_flags;
+
+	cb.autolink = EVENT_SKIP(skip, MKDN_AUTOLINK) ? NULL : event_autolink;
+	cb.codespan = EVENT_SKIP(skip, MKDN_CODESPAN) ? NULL : event_span;
+	cb.double_emphasis = EVENT_SKIP(skip, MKDN_DOUBLE_EMPHASIS) ? NULL : event_span;
+	cb.emphasis = EVENT_SKIP(skip, MKDN_EMPHASIS) ? NULL : event_span;
+	cb.image = EVENT_SKIP(skip, MKDN_IMAGE) ? NULL : event_link;
+	cb.linebreak = EVENT_SKIP(skip, MKDN_LINEBREAK) ? NULL : event_linebreak;
+	cb.link = EVENT_SKIP(skip, MKDN_LINK) ? NULL : event_link;
+	cb.raw_html_tag = EVENT_SKIP(skip, MKDN_RAW_HTML) ? NULL : event_span;
+	cb.triple_emphasis = EVENT_SKIP(skip, MKDN_TRIPLE_EMPHASIS) ? NULL : event_span;
+	cb.strikethrough = EVENT_SKIP(skip, MKDN_STRIKETHROUGH) ? NULL : event_span;
+	cb.superscript = EVENT_SKIP(skip, MKDN_SUPERSCRIPT) ? NULL : event_span;
+
+	cfg = sd_config_new(extensions, max_nesting, &cb);
+	if (!cfg)
+		return NULL;
+
+	cfg->events = *events;
+	cfg->hash = bufhash(&cfg->events, sizeof(struct sd_events), cfg->hash);
+	return cfg;
+}
+
+void
+sd_config_free(struct sd_config *cfg)
+{
+	free(cfg);
+}
+
+struct sd_markdown *
+sd_markdown_new_context(const struct sd_config *cfg, void *opaque)
+{
+	struct sd_markdown *md = NULL;
+
+	assert(cfg);
+
+	md = malloc(sizeof(struct sd_markdown));
+	if (!md)
+		return NULL;
+
+	if (context_init(md, cfg, opaque) < 0) {
+		free(md);
+		return NULL;
+	}
+
+	return md;
+}
+
+struct sd_markdown *
+sd_markdown_new(
+	unsigned int extensions,
+	size_t max_nesting,
+	const struct sd_callbacks *callbacks,
+	void *opaque)
+{
+	struct sd_config *cfg;
+	struct sd_markdown *md;
+
+	cfg = sd_config_new(extensions, max_nesting, callbacks);
+	if (!cfg)
+		return NULL;
+
+	md = sd_markdown_new_context(cfg, opaque);
+	if (!md) {
+		sd_config_free(cfg);
+		return NULL;
+	}
+
+	md->own_cfg = cfg;
+	return md;
+}
+
+/* release_work_bufs • frees the pooled working buffers */
+static void
+release_work_bufs(struct sd_markdown *md)
+{
+	size_t i, t;
+
+	for (t = 0; t < 2; ++t) {
+		struct stack *pool = &md->work_bufs[t];
+
+		for (i = 0; i < pool->asize; ++i) {
+			bufrelease(pool->item[i]);
+			pool->item[i] = NULL;
+		}
+	}
+
+	bufrelease(md->quote_work);
+	md->quote_work = NULL;
+
+	bufrelease(md->text_work);
+	md->text_work = NULL;
+
+	bufrelease(md->line_work);
+	md->line_work = NULL;
+}
+
+int
+sd_markdown_use_arena(struct sd_markdown *md, size_t chunk_size)
+{
+	/* pooled buffers may belong to the previous allocator */
+	release_work_bufs(md);
+	bufarena_free(&md->arena);
+	md->mem_work.parent = NULL;
+
+	if (chunk_size == 0)
+		return 0;
+
+	if (bufarena_init(&md->arena, chunk_size) < 0)
+		return -1;
+
+	md->mem_work.parent = &md->arena.alloc;
+	return 0;
+}
+
+void
+sd_markdown_set_memory_limit(struct sd_markdown *md, size_t max_bytes)
+{
+	md->mem_limit = max_bytes;
+}
+
+size_t
+sd_markdown_memory_peak(struct sd_markdown *md)
+{
+	return md->mem_peak;
+}
+
+void
+sd_markdown_set_threads(struct sd_markdown *md, unsigned int nthreads)
+{
+	md->threads = nthreads ? nthreads : 1;
+}
+
+int
+sd_markdown_set_stats(struct sd_markdown *md, struct sd_render_stats *stats)
+{
+#ifdef SUNDOWN_STATS
+	md->stats = stats;
+	return 0;
+#else
+	(void)md;
+	(void)stats;
+	return -1;
+#endif
+}
+
+uint64_t
+sd_markdown_config_hash(const struct sd_markdown *md)
+{
+	return md->cfg->hash;
+}
+
+int
+sd_markdown_use_cache(struct sd_markdown *md, struct sd_cache *cache, unsigned int render_flags)
+{
+	md->cache = NULL;
+
+	if (cache && !md->cache_refs) {
+		md->cache_refs = bufnew(256);
+		md->cache_key = bufnew(4096);
+		if (!md->cache_refs || !md->cache_key)
+			return MKD_ENOMEM;
+	}
+
+	/* blocks and whole documents never share a key */
+	md->cache = cache;
+	md->cache_settings = CACHE_SETTINGS(md, render_flags) ^ UINT64_C(0x626c6f636b);
+	return MKD_OK;
+}
+
+int
+sd_markdown_render(struct buf *ob, const uint8_t *document, size_t doc_size, struct sd_markdown *md)
+{
+#define MARKDOWN_GROW(x) ((x) + ((x) >> 1))
+	static const char UTF8_BOM[] = {0xEF, 0xBB, 0xBF};
+
+	struct buf *text;
+	uint8_t *data;
+	size_t beg, end, size, out_size;
+	const struct buf_allocator *out_alloc;
+#ifdef SUNDOWN_STATS
+	double clock = 0;
+
+	if (md->stats) {
+		memset(md->stats, 0x0, sizeof(struct sd_render_stats));
+		clock = stat_clock();
+	}
+#endif
+
+	md->status = MKD_OK;
+	md->mem_peak = md->mem_used;
+
+	/* the copy of a small document reuses the previous one */
+	text = md->text_work;
+	md->text_work = NULL;
+
+	if (text)
+		text->size = 0;
+	else {
+		text = bufnew_with(64, md->alloc);
+		if (!text)
+			return md->status;
+
+		text->growth = BUF_GROW_CAPPED;
+	}
+
+	reset_lines(md);
+
+	/* reset the references table */
+	md->ref_list = NULL;
+	md->refs = NULL;
+	md->refs_size = 0;
+
+	/* first pass: looking for references, copying everything else */
+	beg = 0;
+
+	/* Skip a possible UTF-8 BOM, even though the Unicode standard
+	 * discourages having these in UTF-8 documents */
+	if (doc_size >= 3 && memcmp(document, UTF8_BOM, 3) == 0)
+		beg += 3;
+
+	data = (uint8_t *)document + beg;
+	size = doc_size - beg;
+	md->in_place = is_normalized(data, size);
+
+	/* Preallocate enough space for our buffer to avoid expanding while copying */
+	if (!md->in_place)
+		bufgrow(text, doc_size);
+
+	/* normalized input is only copied between references, in bulk;
+	 * without any reference it is parsed where it lies */
+	if (md->in_place) {
+		size_t run = beg, skipped = beg;
+
+		while (beg < doc_size) {
+			if (is_ref(document, beg, doc_size, &end, &md->ref_list, md->alloc)) {
+				if (text->size == 0)
+					bufgrow(text, doc_size);
+
+				bufput(text, document + run, beg - run);
+				skipped += end - beg;
+				beg = run = end;
+			} else {
+				const uint8_t *eol = memchr(document + beg, '\n', doc_size - beg);
+				end = eol ? (size_t)(eol - document) + 1 : doc_size;
+				add_line(md, document + beg, end - beg, end - skipped);
+				beg = end;
+			}
+		}
+
+		if (run > (size_t)(data - document)) {
+			bufput(text, document + run, doc_size - run);
+			md->in_place = 0;
+		}
+	}
+
+	else
+		copy_text(md, text, document, beg, doc_size, NULL);
+
+	/* references are all known: sizing their lookup table */
+	index_link_refs(md);
+
+#ifdef SUNDOWN_STATS
+	if (md->stats) {
+		md->stats->ref_time = stat_clock() - clock;
+		clock = stat_clock();
+	}
+#endif
+
+	/* the output buffer is charged to the budget while rendering */
+	out_alloc = ob->alloc;
+	mem_tracker_init(&md->mem_out, md, out_alloc);
+	ob->alloc = &md->mem_out.hooks;
+	md->mem_used += ob->asize;
+
+	/* pre-grow the output buffer to minimize allocations;
+	 * streamed output never holds the whole document */
+	if (!md->in_place)
+		size = text->size;
+
+	out_size = md->sink ? ob->asize : MARKDOWN_GROW(size);
+	if (md->mem_limit && out_size > ob->asize &&
+		md->mem_used + out_size - ob->asize > md->mem_limit)
+		out_size = ob->asize;
+
+	if (md->status == MKD_OK)
+		bufgrow(ob, out_size);
+
+	/* second pass: actual rendering */
+	doc_header(ob, md);
+
+	if (md->in_place) {
+		index_lines(md, data, size);
+		render_blocks(ob, md, data, size);
+	}
+
+	else if (text->size) {
+		index_lines(md, text->data, text->size);
+		render_blocks(ob, md, text->data, text->size);
+	}
+
+	md->in_place = 0;
+
+	doc_footer(ob, md);
+
+#ifdef SUNDOWN_STATS
+	if (md->stats)
+		md->stats->render_time = stat_clock() - clock;
+#endif
+
+	/* clean-up */
+	if (text->asize <= TEXT_KEEP)
+		md->text_work = text;
+	else
+		bufrelease(text);
+
+	free_link_refs(md);
+
+	md->lines = NULL;
+	md->line_count = 0;
+	md->line_data = NULL;
+	md->line_size = 0;
+
+	md->mem_used -= ob->asize;
+	ob->alloc = out_alloc;
+
+	assert(md->work_bufs[BUFFER_SPAN].size == 0);
+	assert(md->work_bufs[BUFFER_BLOCK].size == 0);
+
+	/* everything allocated during the render goes away at once;
+	 * after a failure the pool may hold untracked buffers */
+	if (md->mem_work.parent == &md->arena.alloc || md->status != MKD_OK)
+		release_work_bufs(md);
+
+	bufarena_reset(&md->arena);
+
+	return md->status;
+}
+
+int
+sd_markdown_render_stream(const uint8_t *document, size_t doc_size, struct sd_markdown *md,
+	sd_output_sink sink, void *sink_opaque)
+{
+	struct buf *ob;
+	int status;
+
+	assert(sink);
+
+	ob = bufnew(SINK_UNIT);
+	if (!ob)
+		return MKD_ENOMEM;
+
+	ob->growth = BUF_GROW_CAPPED;
+
+	md->sink = sink;
+	md->sink_opaque = sink_opaque;
+
+	status = sd_markdown_render(ob, document, doc_size, md);
+
+	/* whatever was rendered goes out, even from a truncated render */
+	if (status != MKD_ESINK && ob->size && sink(ob->data, ob->size, sink_opaque) != 0)
+		status = MKD_ESINK;
+
+	md->sink = NULL;
+	md->sink_opaque = NULL;
+
+	bufrelease(ob);
+	return status;
+}
+
+struct sd_document *
+sd_document_new(const struct sd_config *cfg, void *opaque)
+{
+	struct sd_document *doc;
+	const struct buf_allocator *alloc;
+
+	doc = calloc(1, sizeof(struct sd_document));
+	if (!doc)
+		return NULL;
+
+	doc->md = sd_markdown_new_context(cfg, opaque);
+	if (!doc->md) {
+		free(doc);
+		return NULL;
+	}
+
+	alloc = doc->md->alloc;
+	doc->source = bufnew_with(1024, alloc);
+	doc->text = bufnew_with(1024, alloc);
+	doc->steps = bufnew_with(64 * sizeof(struct text_step), alloc);
+	doc->next = bufnew_with(1024, alloc);
+	doc->next_steps = bufnew_with(16 * sizeof(struct text_step), alloc);
+	doc->next_lines = bufnew_with(16 * sizeof(struct line_info), alloc);
+	doc->html = bufnew_with(1024, alloc);
+	doc->blocks = bufnew_with(64 * sizeof(struct block_mark), alloc);
+	doc->fresh = bufnew_with(16 * sizeof(struct block_mark), alloc);
+	doc->work = bufnew_with(1024, alloc);
+
+	if (!doc->source || !doc->text || !doc->steps || !doc->next ||
+		!doc->next_steps || !doc->next_lines || !doc->html ||
+		!doc->blocks || !doc->fresh || !doc->work) {
+		sd_document_free(doc);
+		return NULL;
+	}
+
+	return doc;
+}
+
+int
+sd_document_update(struct sd_document *doc, const uint8_t *document, size_t doc_size)
+{
+	size_t old_size = doc->source->size, size, pre, suf;
+
+	size = old_size < doc_size ? old_size : doc_size;
+	pre = common_prefix(doc->source->data, document, size);
+	suf = common_suffix(doc->source->data, old_size, document, doc_size, size - pre);
+
+	if (buf_splice(doc->source, pre, old_size - pre - suf,
+		document + pre, doc_size - pre - suf) < 0) {
+		doc->valid = 0;
+		return MKD_ENOMEM;
+	}
+
+	return document_refresh(doc, pre, suf, old_size);
+}
+
+int
+sd_document_edit(struct sd_document *doc, size_t offset, size_t removed,
+	const uint8_t *data, size_t size)
+{
+	size_t old_size = doc->source->size;
+
+	if (offset > old_size)
+		offset = old_size;
+
+	if (removed > old_size - offset)
+		removed = old_size - offset;
+
+	if (buf_splice(doc->source, offset, removed, data, size) < 0) {
+		doc->valid = 0;
+		return MKD_ENOMEM;
+	}
+
+	return document_refresh(doc, offset, old_size - offset - removed, old_size);
+}
+
+const struct buf *
+sd_document_output(const struct sd_document *doc)
+{
+	return doc->html;
+}
+
+void
+sd_document_free(struct sd_document *doc)
+{
+	if (!doc)
+		return;
+
+	bufrelease(doc->source);
+	bufrelease(doc->text);
+	bufrelease(doc->steps);
+	bufrelease(doc->next);
+	bufrelease(doc->next_steps);
+	bufrelease(doc->next_lines);
+	bufrelease(doc->html);
+	bufrelease(doc->blocks);
+	bufrelease(doc->fresh);
+	bufrelease(doc->work);
+
+	free_link_refs(doc->md);
+	sd_markdown_free(doc->md);
+	free(doc);
+}
+
+void
+sd_markdown_free(struct sd_markdown *md)
+{
+	release_work_bufs(md);
 
 	stack_free(&md->work_bufs[BUFFER_SPAN]);
 	stack_free(&md->work_bufs[BUFFER_BLOCK]);
 
+	bufarena_free(&md->arena);
+	bufrelease(md->cache_refs);
+	bufrelease(md->cache_key);
+	sd_config_free(md->own_cfg);
 	free(md);
 }
 
@@ -99,12 +99,165 @@ struct sd_callbacks {
 	void (*doc_footer)(struct buf *ob, void *opaque);
 };
 
+/* mkd_node - type of node handed to the event consumers */
+enum mkd_node {
+	/* nodes with children, between their enter and leave events */
+	MKDN_DOCUMENT,
+	MKDN_BLOCKQUOTE,
+	MKDN_HEADER,
+	MKDN_LIST,
+	MKDN_LISTITEM,
+	MKDN_PARAGRAPH,
+	MKDN_TABLE,
+	MKDN_TABLE_HEADER,
+	MKDN_TABLE_BODY,
+	MKDN_TABLE_ROW,
+	MKDN_TABLE_CELL,
+	MKDN_DOUBLE_EMPHASIS,
+	MKDN_EMPHASIS,
+	MKDN_LINK,
+	MKDN_TRIPLE_EMPHASIS,
+	MKDN_STRIKETHROUGH,
+	MKDN_SUPERSCRIPT,
+
+	/* leaves, which only get an enter event */
+	MKDN_BLOCKCODE,
+	MKDN_BLOCKHTML,
+	MKDN_HRULE,
+	MKDN_AUTOLINK,
+	MKDN_CODESPAN,
+	MKDN_IMAGE,
+	MKDN_LINEBREAK,
+	MKDN_RAW_HTML,
+	MKDN_ENTITY,
+	MKDN_TEXT,
+};
+
+/* sd_node - a node of the document, valid during its events only */
+struct sd_node {
+	enum mkd_node type;
+	int flags;	/* list, list item and table cell flags */
+	int level;	/* header level */
+	enum mkd_autolink autolink;	/* autolink type */
+	size_t rewind;	/* autolink: bytes of the text before it that are part of the link */
+	const struct buf *text;	/* leaves: their text, the alt text of an image */
+	const struct buf *link;	/* link, image, autolink */
+	const struct buf *title;	/* link, image */
+	const struct buf *lang;	/* blockcode */
+	const uint8_t *source;	/* inline nodes: their text as written, markup included */
+	size_t source_size;
+	size_t lead, trail;	/* spans with children: bytes of markup at either end of source */
+	size_t base;	/* where the content of the enclosing node starts in ob */
+	size_t offset;	/* where this node starts in ob */
+	size_t content;	/* where its children start in ob, once entered */
+};
+
+/* sd_events - SAX-style rendering: the children of a node are rendered
+ * straight into the output between its enter and leave events, so no
+ * working buffer is copied into its parent. ob->size - node->base stands
+ * for the ob->size of a callback, and the children of a node lie from
+ * node->content to ob->size when it is left. Returning 0 from the enter
+ * or the leave of a node drops everything it wrote, the node included;
+ * a dropped span is then printed verbatim, like a span callback
+ * returning 0. The list flags are final when the list is left. The
+ * text is given as written: the spaces before a line break, the '!'
+ * before an image and the rewind of an autolink, which the callbacks cut
+ * from their output, are left for the consumer to cut */
+struct sd_events {
+	int (*enter)(struct buf *ob, const struct sd_node *node, void *opaque);
+	int (*leave)(struct buf *ob, const struct sd_node *node, void *opaque);
+	unsigned int skip;	/* 1 << type of the HTML blocks and spans parsed as if
+			 * they had no callback */
+};
+
+struct sd_config;
 struct sd_markdown;
+struct sd_batch;
+struct sd_document;
+struct sd_cache;
+
+/* sd_slice - a document handed over to the batch renderers */
+struct sd_slice {
+	const uint8_t *data;
+	size_t size;
+};
+
+/* sd_cache_stats - counters of a render cache */
+struct sd_cache_stats {
+	size_t hits;	/* whole documents */
+	size_t misses;
+	size_t block_hits;	/* top-level blocks, see sd_markdown_use_cache */
+	size_t block_misses;
+	size_t evictions;
+	size_t entries;
+	size_t bytes;	/* held by the entries, their documents included */
+};
+
+/* mkd_stat_trigger - active char handlers, in sd_render_stats */
+enum mkd_stat_trigger {
+	MKDS_EMPHASIS,
+	MKDS_CODESPAN,
+	MKDS_LINEBREAK,
+	MKDS_LINK,
+	MKDS_LANGLE,
+	MKDS_ESCAPE,
+	MKDS_ENTITY,
+	MKDS_AUTOLINK_URL,
+	MKDS_AUTOLINK_EMAIL,
+	MKDS_AUTOLINK_WWW,
+	MKDS_SUPERSCRIPT,
+	MKDS_TRIGGERS
+};
+
+/* mkd_stat_block - block parsers, in sd_render_stats */
+enum mkd_stat_block {
+	MKDS_PARAGRAPH,
+	MKDS_ATXHEADER,
+	MKDS_HTMLBLOCK,	/* the paragraphs look for their end with it too */
+	MKDS_HRULE,
+	MKDS_FENCEDCODE,
+	MKDS_TABLE,
+	MKDS_BLOCKQUOTE,
+	MKDS_BLOCKCODE,
+	MKDS_LIST,
+	MKDS_LISTITEM,
+	MKDS_BLOCKS
+};
+
+/* sd_render_stats - where a render spent its time, see sd_markdown_set_stats;
+ * a call that matched nothing counts as a miss, the bytes are the ones
+ * the matching calls consumed */
+struct sd_render_stats {
+	double ref_time;	/* first pass: references and tabs, in seconds */
+	double render_time;	/* second pass: the blocks and their spans */
+	size_t trigger_calls[MKDS_TRIGGERS];
+	size_t trigger_misses[MKDS_TRIGGERS];
+	size_t trigger_bytes[MKDS_TRIGGERS];
+	size_t block_calls[MKDS_BLOCKS];
+	size_t block_misses[MKDS_BLOCKS];
+	size_t block_bytes[MKDS_BLOCKS];
+	size_t bufs_new;	/* working buffers allocated */
+	size_t bufs_reused;	/* working buffers taken back from the pool */
+	size_t max_depth;	/* most working buffers in use at once */
+	size_t allocs;	/* fresh allocations, output included */
+	size_t reallocs;	/* buffers grown, output included */
+	size_t realloc_bytes;	/* their sizes after growing */
+};
+
+/* sd_output_sink - receives streamed output, non-zero aborts the render */
+typedef int (*sd_output_sink)(const uint8_t *data, size_t size, void *opaque);
 
 /*********
  * FLAGS *
  *********/
 
+/* sd_markdown_render status codes */
+#define MKD_OK		0
+#define MKD_ENOMEM	-1  /* an allocation failed, output is truncated */
+#define MKD_EBUDGET	-2  /* memory limit exceeded, output is truncated */
+#define MKD_ESINK	-3  /* the output sink failed, output is truncated */
+#define MKD_ETREE	-4  /* not a tree, or a truncated one */
+
 /* list/listitem flags */
 #define MKD_LIST_ORDERED	1
 #define MKD_LI_BLOCK		2  /* <li> containing block data */
@@ -113,6 +266,34 @@ struct sd_markdown;
  * EXPORTED FUNCTIONS *
  **********************/
 
+/* sd_config_new • parser settings that renders only read: one config
+ * can be shared by any number of contexts, on any number of threads */
+extern struct sd_config *
+sd_config_new(
+	unsigned int extensions,
+	size_t max_nesting,
+	const struct sd_callbacks *callbacks);
+
+/* sd_config_new_events • parser settings rendering through events
+ * instead of callbacks; the contexts made from it are used as any other */
+extern struct sd_config *
+sd_config_new_events(
+	unsigned int extensions,
+	size_t max_nesting,
+	const struct sd_events *events);
+
+/* sd_config_free • the contexts made from cfg must be freed first */
+extern void
+sd_config_free(struct sd_config *cfg);
+
+/* sd_markdown_new_context • per-render state over a shared config;
+ * a context renders one document at a time, so each thread needs its
+ * own. It is cheap to make and keeps its working buffers between
+ * renders */
+extern struct sd_markdown *
+sd_markdown_new_context(const struct sd_config *cfg, void *opaque);
+
+/* sd_markdown_new • a context with a config of its own */
 extern struct sd_markdown *
 sd_markdown_new(
 	unsigned int extensions,
@@ -120,12 +301,184 @@ sd_markdown_new(
 	const struct sd_callbacks *callbacks,
 	void *opaque);
 
-extern void
+extern int
 sd_markdown_render(struct buf *ob, const uint8_t *document, size_t doc_size, struct sd_markdown *md);
 
+/* sd_markdown_render_stream • renders through a sink instead of a buffer;
+ * output is handed over in chunks as top-level blocks are completed */
+extern int
+sd_markdown_render_stream(const uint8_t *document, size_t doc_size, struct sd_markdown *md,
+	sd_output_sink sink, void *sink_opaque);
+
+/* sd_markdown_render_batch • renders count documents on up to nthreads
+ * threads, with a context over cfg for each thread: outputs[i] gets the
+ * rendering of docs[i], and status[i], when status is not NULL, its
+ * status code: a one-off sd_batch, rendering into the caller's buffers.
+ * As with sd_markdown_set_threads, opaque is shared by the threads, and
+ * the callbacks must not keep state of their own. Returns MKD_OK, or the
+ * status of the first document that failed */
+extern int
+sd_markdown_render_batch(const struct sd_config *cfg, void *opaque,
+	const struct sd_slice *docs, struct buf **outputs, int *status,
+	size_t count, unsigned int nthreads);
+
 extern void
 sd_markdown_free(struct sd_markdown *md);
 
+/* sd_batch_new • batch renderer over cfg for lots of small documents:
+ * each of its nthreads threads keeps one context from call to call, and
+ * up to max_bytes of the outputs of a call, 0 standing for
+ * BUFFER_MAX_ALLOC_SIZE; the documents past it fail with MKD_ENOMEM */
+extern struct sd_batch *
+sd_batch_new(const struct sd_config *cfg, void *opaque, unsigned int nthreads,
+	size_t max_bytes);
+
+/* sd_batch_render • renders count documents, sharing them out between
+ * the threads, which steal from each other once done with their share.
+ * outputs[i] gets the rendering of docs[i] and status[i], when status is
+ * not NULL, its status code. The outputs lie in buffers owned by the
+ * batch, one per thread, valid until its next call. Returns MKD_OK, or
+ * the status of the first document that failed */
+extern int
+sd_batch_render(struct sd_batch *batch, const struct sd_slice *docs,
+	struct sd_slice *outputs, int *status, size_t count);
+
+extern void
+sd_batch_free(struct sd_batch *batch);
+
+/* sd_document_new • a document kept rendered while it is being edited:
+ * each update parses again only the top-level blocks the change may
+ * reach, and splices their output into the previous one. The callbacks
+ * must render a block the same wherever it lies in the document, so the
+ * ones numbering headers (HTML_TOC, the TOC renderer) are not fit */
+extern struct sd_document *
+sd_document_new(const struct sd_config *cfg, void *opaque);
+
+/* sd_document_update • gives the whole text of the document again;
+ * the changed range is found by comparing it with the previous one.
+ * Adding, removing or changing a reference definition renders all of
+ * it again. After a failure, the output stays incomplete until the next
+ * update that succeeds */
+extern int
+sd_document_update(struct sd_document *doc, const uint8_t *document, size_t doc_size);
+
+/* sd_document_edit • replaces removed bytes at offset in the last text
+ * given with size bytes of data, then updates the render as above */
+extern int
+sd_document_edit(struct sd_document *doc, size_t offset, size_t removed,
+	const uint8_t *data, size_t size);
+
+/* sd_document_output • rendering of the document, valid until the
+ * next update */
+extern const struct buf *
+sd_document_output(const struct sd_document *doc);
+
+extern void
+sd_document_free(struct sd_document *doc);
+
+/* sd_cache_new • keeps the output of the documents rendered through it,
+ * up to max_bytes with the documents themselves; the least recently
+ * used ones go first. A cache is not locked: each thread needs its own,
+ * or a lock around its calls */
+extern struct sd_cache *
+sd_cache_new(size_t max_bytes);
+
+/* sd_cache_render • appends the rendering of a document to ob, from the
+ * cache when the same bytes went through it with the same extensions,
+ * nesting limit, callbacks and render_flags, after the same last byte of
+ * ob (or into an empty one, as the case may be); otherwise renders it with md
+ * and keeps the output if the render succeeded. render_flags stands for
+ * whatever else of opaque the callbacks read, html_renderopt.flags for the
+ * HTML renderer; callbacks keeping state across renders (HTML_TOC) are not
+ * fit */
+extern int
+sd_cache_render(struct sd_cache *cache, struct buf *ob, const uint8_t *document,
+	size_t doc_size, struct sd_markdown *md, unsigned int render_flags);
+
+extern void
+sd_cache_stats(const struct sd_cache *cache, struct sd_cache_stats *stats);
+
+/* sd_cache_clear • drops every entry, the counters are kept */
+extern void
+sd_cache_clear(struct sd_cache *cache);
+
+extern void
+sd_cache_free(struct sd_cache *cache);
+
+/* sd_tree_events • events writing the document as a flat tree into the
+ * output, for sd_config_new_events: the tree holds no pointer, so it can
+ * be kept, written to disk or mapped back, and rendered any number of
+ * times by sd_tree_render without parsing the text again. The nodes in
+ * skip are parsed as text, as with sd_events */
+extern void
+sd_tree_events(struct sd_events *events, unsigned int skip);
+
+/* sd_tree_render • renders a tree through callbacks, into the same output
+ * as a render of its text with them and a config of the same extensions,
+ * nesting limit and skipped nodes. A node whose callback is NULL or
+ * returns 0 is printed as written, as by a parse, from the source the
+ * tree keeps; the content of a refused span is the one parsed inside
+ * it, though, where a parse goes over it again: markup reaching past
+ * its brackets, or emphasis MKDEXT_NO_INTRA_EMPHASIS takes as intraword
+ * after them, can come out differently. Returns MKD_ETREE for a buffer
+ * that is not a whole tree */
+extern int
+sd_tree_render(struct buf *ob, const uint8_t *tree, size_t tree_size,
+	const struct sd_callbacks *callbacks, void *opaque);
+
+/* sd_markdown_use_arena • bump-allocates all the per-render memory
+ * (working buffers, link references, table columns) from an arena
+ * that is reset at the end of each render; 0 goes back to the heap */
+extern int
+sd_markdown_use_arena(struct sd_markdown *md, size_t chunk_size);
+
+/* sd_markdown_set_memory_limit • caps the bytes held by the parser
+ * (working buffers, link references, output) during a render; going
+ * over makes sd_markdown_render return MKD_EBUDGET. 0 only keeps the
+ * default 16MB ceiling per buffer */
+extern void
+sd_markdown_set_memory_limit(struct sd_markdown *md, size_t max_bytes);
+
+/* sd_markdown_memory_peak • highest byte count held during the last render */
+extern size_t
+sd_markdown_memory_peak(struct sd_markdown *md);
+
+/* sd_markdown_set_threads • renders large documents on up to nthreads
+ * threads: the text is cut between top-level blocks, and the slices are
+ * rendered side by side then joined in order, into the same output as a
+ * serial render. The callbacks then run concurrently on one opaque
+ * pointer, so they must not keep state from one block to the next
+ * (HTML_TOC and the TOC renderer number their headers), nor look further
+ * back into the output than its last byte. The scratch memory of the
+ * other threads is left out of the memory limit, so a render that runs
+ * short of it may stop at another block than a serial one. Streamed
+ * renders, and documents under 128KB, stay on one thread; 0 or 1
+ * disables it */
+extern void
+sd_markdown_set_threads(struct sd_markdown *md, unsigned int nthreads);
+
+/* sd_markdown_use_cache • renders the top-level blocks through cache,
+ * NULL going back to plain renders: a block is copied from it when it
+ * was rendered before from the same text, as far as its parse may look
+ * past it, after the same output byte and with the same definitions for
+ * the references it uses. render_flags is as in sd_cache_render; blocks
+ * rendered side by side (sd_markdown_set_threads) or by an sd_document
+ * skip the cache */
+extern int
+sd_markdown_use_cache(struct sd_markdown *md, struct sd_cache *cache, unsigned int render_flags);
+
+/* sd_markdown_set_stats • has each render of md fill stats, until it is
+ * set back to NULL. Builds without SUNDOWN_STATS have no counters at all
+ * and return -1. Blocks rendered side by side (sd_markdown_set_threads)
+ * only count their time */
+extern int
+sd_markdown_set_stats(struct sd_markdown *md, struct sd_render_stats *stats);
+
+/* sd_markdown_config_hash • hash of the callbacks, extensions and nesting
+ * limit md renders with, for caches keyed on the output */
+extern uint64_t
+sd_markdown_config_hash(const struct sd_markdown *md);
+
 extern void
 sd_version(int *major, int *minor, int *revision);
 
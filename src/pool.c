@@ -0,0 +1,219 @@
+/* pool.c - fork/join worker threads */
+
+/*
+ * Copyright (c) 2026, agent
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "pool.h"
+#include <stdlib.h>
+
+#if defined(SUNDOWN_NO_THREADS)
+	/* everything runs in the calling thread */
+#elif defined(_WIN32)
+#	include <windows.h>
+#	define POOL_THREADS 1
+#else
+#	include <pthread.h>
+#	define POOL_THREADS 1
+#endif
+
+#if defined(_WIN32) && defined(POOL_THREADS)
+typedef CRITICAL_SECTION pool_lock;
+#	define pool_lock_init(l)	InitializeCriticalSection(l)
+#	define pool_lock_free(l)	DeleteCriticalSection(l)
+#	define pool_lock_get(l)	EnterCriticalSection(l)
+#	define pool_lock_put(l)	LeaveCriticalSection(l)
+#elif defined(POOL_THREADS)
+typedef pthread_mutex_t pool_lock;
+#	define pool_lock_init(l)	pthread_mutex_init(l, NULL)
+#	define pool_lock_free(l)	pthread_mutex_destroy(l)
+#	define pool_lock_get(l)	pthread_mutex_lock(l)
+#	define pool_lock_put(l)	pthread_mutex_unlock(l)
+#else
+typedef int pool_lock;
+#	define pool_lock_init(l)	((void)(l))
+#	define pool_lock_free(l)	((void)(l))
+#	define pool_lock_get(l)	((void)(l))
+#	define pool_lock_put(l)	((void)(l))
+#endif
+
+struct pool_job {
+	pool_task task;
+	void *opaque;
+	unsigned int nthreads;
+	struct pool_worker *workers;
+};
+
+/* pool_worker: a thread, and the tasks still queued on it */
+struct pool_worker {
+	struct pool_job *job;
+	unsigned int id;
+	pool_lock lock;
+	size_t next, end;	/* taken from the front by the owner,
+				 * from the back by the others */
+#if defined(_WIN32) && defined(POOL_THREADS)
+	HANDLE thread;
+#elif defined(POOL_THREADS)
+	pthread_t thread;
+#endif
+};
+
+/* pool_take • next task of the worker's own queue */
+static int
+pool_take(struct pool_worker *worker, size_t *task)
+{
+	int found = 0;
+
+	pool_lock_get(&worker->lock);
+	if (worker->next < worker->end) {
+		*task = worker->next++;
+		found = 1;
+	}
+	pool_lock_put(&worker->lock);
+
+	return found;
+}
+
+/* pool_steal • moves the back half of another queue onto this one */
+static int
+pool_steal(struct pool_worker *worker)
+{
+	struct pool_job *job = worker->job;
+	unsigned int i;
+
+	for (i = 1; i < job->nthreads; ++i) {
+		struct pool_worker *victim = &job->workers[(worker->id + i) % job->nthreads];
+		size_t beg = 0, end = 0;
+
+		pool_lock_get(&victim->lock);
+		if (victim->next < victim->end) {
+			end = victim->end;
+			beg = end - (end - victim->next + 1) / 2;
+			victim->end = beg;
+		}
+		pool_lock_put(&victim->lock);
+
+		if (beg < end) {
+			pool_lock_get(&worker->lock);
+			worker->next = beg;
+			worker->end = end;
+			pool_lock_put(&worker->lock);
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+static void
+pool_work(struct pool_worker *worker)
+{
+	struct pool_job *job = worker->job;
+	size_t i;
+
+	do {
+		while (pool_take(worker, &i))
+			job->task(job->opaque, i, worker->id);
+	} while (pool_steal(worker));
+}
+
+#if defined(_WIN32) && defined(POOL_THREADS)
+static DWORD WINAPI
+pool_thread(LPVOID arg)
+{
+	pool_work(arg);
+	return 0;
+}
+#elif defined(POOL_THREADS)
+static void *
+pool_thread(void *arg)
+{
+	pool_work(arg);
+	return NULL;
+}
+#endif
+
+int
+pool_run(unsigned int nthreads, size_t count, pool_task task, void *opaque)
+{
+	struct pool_job job;
+	struct pool_worker self, *workers = NULL;
+	unsigned int i, started = 1;
+
+#if defined(POOL_THREADS)
+	if (nthreads > count)
+		nthreads = (unsigned int)count;
+
+	if (nthreads > 1)
+		workers = malloc(nthreads * sizeof(struct pool_worker));
+#endif
+
+	if (!workers) {
+		nthreads = 1;
+		workers = &self;
+	}
+
+	job.task = task;
+	job.opaque = opaque;
+	job.nthreads = nthreads;
+	job.workers = workers;
+
+	/* every thread starts with an even share of the tasks */
+	for (i = 0; i < nthreads; ++i) {
+		struct pool_worker *w = &workers[i];
+
+		w->job = &job;
+		w->id = i;
+		w->next = count / nthreads * i + (i < count % nthreads ? i : count % nthreads);
+		w->end = w->next + count / nthreads + (i < count % nthreads);
+		pool_lock_init(&w->lock);
+	}
+
+#if defined(POOL_THREADS)
+	/* a thread that cannot be started gets its share stolen */
+	for (; started < nthreads; ++started) {
+		struct pool_worker *w = &workers[started];
+#	if defined(_WIN32)
+		w->thread = CreateThread(NULL, 0, pool_thread, w, 0, NULL);
+		if (w->thread == NULL)
+			break;
+#	else
+		if (pthread_create(&w->thread, NULL, pool_thread, w) != 0)
+			break;
+#	endif
+	}
+#endif
+
+	pool_work(&workers[0]);
+
+#if defined(POOL_THREADS)
+	for (i = 1; i < started; ++i) {
+#	if defined(_WIN32)
+		WaitForSingleObject(workers[i].thread, INFINITE);
+		CloseHandle(workers[i].thread);
+#	else
+		pthread_join(workers[i].thread, NULL);
+#	endif
+	}
+#endif
+
+	for (i = 0; i < nthreads; ++i)
+		pool_lock_free(&workers[i].lock);
+
+	if (workers != &self)
+		free(workers);
+
+	return (int)started;
+}
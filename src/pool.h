@@ -0,0 +1,43 @@
+/* pool.h - fork/join worker threads */
+
+/*
+ * Copyright (c) 2026, agent
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef POOL_H__
+#define POOL_H__
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* pool_task • runs task number index on the given worker */
+typedef void (*pool_task)(void *opaque, size_t index, unsigned int worker);
+
+/* pool_run • runs tasks 0 to count - 1 on up to nthreads threads,
+ * the calling one included, and returns how many threads ran once
+ * all of them are done. Each thread starts on an even share of the
+ * tasks, in order, and steals the back half of another share once its
+ * own runs out; worker numbers stay below nthreads. Builds defining
+ * SUNDOWN_NO_THREADS run them all in the calling thread, as worker 0 */
+int pool_run(unsigned int nthreads, size_t count, pool_task task, void *opaque);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
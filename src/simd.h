@@ -0,0 +1,64 @@
+/* simd.h - vector instruction selection for the byte scanners */
+
+/*
+ * Copyright (c) 2026, agent
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef UPSKIRT_SIMD_H
+#define UPSKIRT_SIMD_H
+
+/*
+ * The instruction set is picked at compile time: SSE2 is always there
+ * on x86-64, SSSE3 and AVX2 need the matching -m flags (or -march).
+ * Define SUNDOWN_NO_SIMD to build the plain byte loops only.
+ */
+#if !defined(SUNDOWN_NO_SIMD)
+#	if defined(__AVX2__)
+#		define SD_SIMD_AVX2 1
+#	endif
+#	if defined(__SSSE3__) || defined(__AVX2__)
+#		define SD_SIMD_SSSE3 1
+#	endif
+#	if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#		define SD_SIMD_SSE2 1
+#	endif
+#endif
+
+#if defined(SD_SIMD_AVX2)
+#	include <immintrin.h>
+#elif defined(SD_SIMD_SSSE3)
+#	include <tmmintrin.h>
+#elif defined(SD_SIMD_SSE2)
+#	include <emmintrin.h>
+#endif
+
+#if defined(SD_SIMD_SSE2)
+#	if defined(_MSC_VER)
+#		include <intrin.h>
+static __inline unsigned int
+sd_ctz(unsigned int mask)
+{
+	unsigned long i;
+	_BitScanForward(&i, mask);
+	return (unsigned int)i;
+}
+#	else
+#		define sd_ctz(mask) ((unsigned int)__builtin_ctz(mask))
+#	endif
+#endif
+
+#endif
+
+/* vim: set filetype=c: */
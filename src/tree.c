@@ -0,0 +1,822 @@
+/* tree.c - documents parsed once into a flat tree, rendered many times */
+
+/*
+ * Copyright (c) 2026, agent
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "markdown.h"
+#include "stack.h"
+
+#include <string.h>
+
+/* A tree is the magic bytes, then one record per top-level block. A
+ * record is the node type, an argument byte, its payload size, then the
+ * payload:
+ *
+ *	header, list, list item, table cell	children; arg is the level or flags
+ *	link	link, title, lead and trail strings, then children
+ *	other spans	lead and trail strings, then children
+ *	other nodes with children	children
+ *	blockcode	text and lang strings
+ *	codespan	text string, then the source
+ *	image	link, title and alt strings, then the source
+ *	autolink	rewind as 32 bits, the link string, then the source; arg is its type
+ *	other leaves	their text, TREE_NULL in arg when there is none
+ *
+ * The size takes 32 bits little-endian, or a single byte when TREE_SHORT
+ * is set in the type, as it is for the leaves under 256 bytes. A string
+ * is its size as 32 bits, or TREE_NONE when missing, then its bytes.
+ * The source of a node, and the lead and trail markup of a span, are its
+ * text as written: what the render prints where a callback refuses the
+ * node, as the parser would. Nothing in a tree depends on where it lies
+ * in memory */
+
+#define TREE_HEADER 6	/* type, arg and size of a record */
+#define TREE_SHORT 0x80	/* in the type: a single byte of size follows */
+#define TREE_NONE 0xffffffffu	/* size of a missing string */
+#define TREE_NULL 0x80	/* arg of a leaf without text */
+#define TREE_MAX_DEPTH 1024	/* deeper trees are refused */
+
+static const uint8_t tree_magic[4] = { 's', 'd', 't', 2 };
+
+/* tree_walk • state of a render through callbacks */
+struct tree_walk {
+	const struct sd_callbacks *cb;
+	void *opaque;
+	struct stack work_bufs;	/* one for each node being rendered */
+	size_t depth;
+	int status;
+};
+
+/* tree_rec • a record as read from the tree */
+struct tree_rec {
+	enum mkd_node type;
+	int arg;
+	const uint8_t *data;	/* payload */
+	size_t size;
+};
+
+static void
+tree_set32(uint8_t *dst, size_t value)
+{
+	dst[0] = value & 0xff;
+	dst[1] = (value >> 8) & 0xff;
+	dst[2] = (value >> 16) & 0xff;
+	dst[3] = (value >> 24) & 0xff;
+}
+
+static size_t
+tree_get32(const uint8_t *src)
+{
+	return (size_t)src[0] | (size_t)src[1] << 8 |
+		(size_t)src[2] << 16 | (size_t)src[3] << 24;
+}
+
+static void
+tree_put32(struct buf *ob, size_t value)
+{
+	uint8_t word[4];
+
+	tree_set32(word, value);
+	bufput(ob, word, 4);
+}
+
+/* tree_putstr • a string, or TREE_NONE for a missing one */
+static void
+tree_putstr(struct buf *ob, const struct buf *str)
+{
+	if (!str) {
+		tree_put32(ob, TREE_NONE);
+		return;
+	}
+
+	tree_put32(ob, str->size);
+	bufput(ob, str->data, str->size);
+}
+
+/* tree_putmarkup • the lead and trail markup of a span */
+static void
+tree_putmarkup(struct buf *ob, const struct sd_node *node)
+{
+	tree_put32(ob, node->lead);
+	bufput(ob, node->source, node->lead);
+	tree_put32(ob, node->trail);
+	bufput(ob, node->source + node->source_size - node->trail, node->trail);
+}
+
+static size_t
+tree_strsize(const struct buf *str)
+{
+	return 4 + (str ? str->size : 0);
+}
+
+/* tree_close • writes the payload size of the record at start */
+static int
+tree_close(struct buf *ob, size_t start)
+{
+	uint64_t size;
+
+	/* a write failed, or the payload does not fit its size */
+	if (ob->size < start + TREE_HEADER)
+		return 0;
+
+	size = ob->size - start - TREE_HEADER;
+	if (size >= TREE_NONE)
+		return 0;
+
+	tree_set32(ob->data + start + 2, (size_t)size);
+	return 1;
+}
+
+/* tree_enter • writes the record of a node, up to its children */
+static int
+tree_enter(struct buf *ob, const struct sd_node *node, void *opaque)
+{
+	const struct buf *text = node->text;
+	uint64_t size = 0;
+	int arg = 0;
+
+	switch (node->type) {
+	case MKDN_DOCUMENT:
+		bufput(ob, tree_magic, sizeof(tree_magic));
+		return 1;
+
+	case MKDN_HEADER:
+		arg = node->level;
+		break;
+
+	case MKDN_LIST:
+	case MKDN_LISTITEM:
+	case MKDN_TABLE_CELL:
+		arg = node->flags;
+		break;
+
+	case MKDN_BLOCKCODE:
+		size = tree_strsize(text) + tree_strsize(node->lang);
+		break;
+
+	case MKDN_CODESPAN:
+		size = tree_strsize(text) + node->source_size;
+		break;
+
+	case MKDN_IMAGE:
+		size = tree_strsize(node->link) + tree_strsize(node->title) + tree_strsize(text) +
+			node->source_size;
+		break;
+
+	case MKDN_AUTOLINK:
+		arg = node->autolink;
+		size = 4 + tree_strsize(node->link) + node->source_size;
+		break;
+
+	case MKDN_BLOCKHTML:
+	case MKDN_RAW_HTML:
+	case MKDN_ENTITY:
+	case MKDN_TEXT:
+		if (text)
+			size = text->size;
+		else
+			arg = TREE_NULL;
+		break;
+
+	default:
+		break;
+	}
+
+	/* the size of a node with children is known once it is left */
+	if (node->type < MKDN_BLOCKCODE) {
+		bufputc(ob, node->type);
+		bufputc(ob, arg);
+		tree_put32(ob, 0);
+
+		if (node->type == MKDN_LINK) {
+			tree_putstr(ob, node->link);
+			tree_putstr(ob, node->title);
+		}
+
+		if (node->type >= MKDN_DOUBLE_EMPHASIS)
+			tree_putmarkup(ob, node);
+
+		return 1;
+	}
+
+	if (size >= TREE_NONE)
+		return 0;
+
+	if (size < 256) {
+		bufputc(ob, node->type | TREE_SHORT);
+		bufputc(ob, arg);
+		bufputc(ob, (int)size);
+	} else {
+		bufputc(ob, node->type);
+		bufputc(ob, arg);
+		tree_put32(ob, (size_t)size);
+	}
+
+	switch (node->type) {
+	case MKDN_BLOCKCODE:
+		tree_putstr(ob, text);
+		tree_putstr(ob, node->lang);
+		break;
+
+	case MKDN_CODESPAN:
+		tree_putstr(ob, text);
+		bufput(ob, node->source, node->source_size);
+		break;
+
+	case MKDN_IMAGE:
+		tree_putstr(ob, node->link);
+		tree_putstr(ob, node->title);
+		tree_putstr(ob, text);
+		bufput(ob, node->source, node->source_size);
+		break;
+
+	case MKDN_AUTOLINK:
+		tree_put32(ob, node->rewind);
+		tree_putstr(ob, node->link);
+		bufput(ob, node->source, node->source_size);
+		break;
+
+	default:
+		if (text)
+			bufput(ob, text->data, text->size);
+		break;
+	}
+
+	return 1;
+}
+
+/* tree_leave • writes the size of a node once its children are in */
+static int
+tree_leave(struct buf *ob, const struct sd_node *node, void *opaque)
+{
+	if (node->type == MKDN_DOCUMENT)
+		return 1;
+
+	/* an empty emphasis is text to the renderers, which refuse it:
+	 * dropped, it is parsed as such */
+	if (node->type >= MKDN_DOUBLE_EMPHASIS && node->type != MKDN_LINK &&
+		ob->size == node->content)
+		return 0;
+
+	/* the flags of a list are only final now */
+	if (node->type == MKDN_LIST && ob->size >= node->offset + TREE_HEADER)
+		ob->data[node->offset + 1] = node->flags;
+
+	return tree_close(ob, node->offset);
+}
+
+/* tree_record • reads the record at the front of data, 0 if it does not fit */
+static size_t
+tree_record(const uint8_t *data, size_t size, struct tree_rec *rec)
+{
+	size_t header = (data[0] & TREE_SHORT) ? 3 : TREE_HEADER;
+
+	if (size < header || (data[0] & ~TREE_SHORT) > MKDN_TEXT)
+		return 0;
+
+	rec->size = header == 3 ? data[2] : tree_get32(data + 2);
+	if (rec->size > size - header)
+		return 0;
+
+	rec->type = (enum mkd_node)(data[0] & ~TREE_SHORT);
+	rec->arg = data[1];
+	rec->data = data + header;
+	return header + rec->size;
+}
+
+/* tree_getstr • takes a string off the front of a payload: 1 when it is
+ * there, 0 when it is missing, -1 when it does not fit */
+static int
+tree_getstr(struct tree_rec *rec, struct buf *str)
+{
+	size_t size;
+
+	if (rec->size < 4)
+		return -1;
+
+	size = tree_get32(rec->data);
+	rec->data += 4;
+	rec->size -= 4;
+
+	if (size == TREE_NONE)
+		return 0;
+
+	if (size > rec->size)
+		return -1;
+
+	memset(str, 0x0, sizeof(struct buf));
+	str->data = (uint8_t *)rec->data;
+	str->size = size;
+	rec->data += size;
+	rec->size -= size;
+	return 1;
+}
+
+static struct buf *
+tree_newbuf(struct tree_walk *w)
+{
+	struct stack *pool = &w->work_bufs;
+	struct buf *work;
+
+	if (pool->size < pool->asize && pool->item[pool->size] != NULL) {
+		work = pool->item[pool->size++];
+		work->size = 0;
+		return work;
+	}
+
+	work = bufnew(64);
+	if (!work || stack_push(pool, work) < 0) {
+		bufrelease(work);
+		w->status = MKD_ENOMEM;
+		return NULL;
+	}
+
+	return work;
+}
+
+static void
+tree_popbuf(struct tree_walk *w)
+{
+	w->work_bufs.size--;
+}
+
+/* tree_text • text written as is, where a parse would have left it verbatim */
+static void
+tree_text(struct tree_walk *w, struct buf *ob, const struct buf *text)
+{
+	if (!text)
+		return;
+
+	if (w->cb->normal_text)
+		w->cb->normal_text(ob, text, w->opaque);
+	else
+		bufput(ob, text->data, text->size);
+}
+
+static void tree_nodes(struct tree_walk *w, struct buf *ob, const uint8_t *data, size_t size);
+
+/* tree_inner • renders the children of a record into a new working buffer */
+static struct buf *
+tree_inner(struct tree_walk *w, const struct tree_rec *rec)
+{
+	struct buf *work = tree_newbuf(w);
+
+	if (work)
+		tree_nodes(w, work, rec->data, rec->size);
+
+	return work;
+}
+
+/* tree_table • renders the header and the body of a table */
+static void
+tree_table(struct tree_walk *w, struct buf *ob, const struct tree_rec *rec)
+{
+	struct buf *header, *body;
+	struct tree_rec part;
+	size_t i = 0, used;
+
+	header = tree_newbuf(w);
+	body = tree_newbuf(w);
+	if (!header || !body)
+		return;
+
+	while (i < rec->size && w->status == MKD_OK) {
+		used = tree_record(rec->data + i, rec->size - i, &part);
+
+		if (!used || (part.type != MKDN_TABLE_HEADER && part.type != MKDN_TABLE_BODY)) {
+			w->status = MKD_ETREE;
+			return;
+		}
+
+		tree_nodes(w, part.type == MKDN_TABLE_HEADER ? header : body, part.data, part.size);
+		i += used;
+	}
+
+	if (w->cb->table && w->status == MKD_OK)
+		w->cb->table(ob, header, body, w->opaque);
+
+	tree_popbuf(w);
+	tree_popbuf(w);
+}
+
+/* tree_markup • takes the lead and trail markup off the front of a span */
+static int
+tree_markup(struct tree_walk *w, struct tree_rec *rec, struct buf *lead, struct buf *trail)
+{
+	if (tree_getstr(rec, lead) < 1 || tree_getstr(rec, trail) < 1) {
+		w->status = MKD_ETREE;
+		return 0;
+	}
+
+	return 1;
+}
+
+/* tree_verbatim • a span its callback refused, as the parser leaves it:
+ * the markup as text around the children, rendered into ob this time */
+static void
+tree_verbatim(struct tree_walk *w, struct buf *ob, const struct tree_rec *rec,
+	const struct buf *lead, const struct buf *trail)
+{
+	tree_text(w, ob, lead);
+	tree_nodes(w, ob, rec->data, rec->size);
+	tree_text(w, ob, trail);
+}
+
+/* tree_span • an inline node with children */
+/*	a refused superscript is dropped, text and all, as by the parser */
+static void
+tree_span(struct tree_walk *w, struct buf *ob, struct tree_rec *rec,
+	int (*render)(struct buf *, const struct buf *, void *))
+{
+	struct buf lead, trail, *work;
+	int r = 0;
+
+	if (!tree_markup(w, rec, &lead, &trail) || (work = tree_inner(w, rec)) == NULL)
+		return;
+
+	if (render && w->status == MKD_OK)
+		r = render(ob, work, w->opaque);
+
+	tree_popbuf(w);
+
+	if (!r && w->status == MKD_OK && !(render && rec->type == MKDN_SUPERSCRIPT))
+		tree_verbatim(w, ob, rec, &lead, &trail);
+}
+
+/* tree_link • a link, its content rendered as a span */
+/*	a refused link without markup, from a www autolink, is dropped as by
+ *	the parser */
+static void
+tree_link(struct tree_walk *w, struct buf *ob, struct tree_rec *rec)
+{
+	struct buf link, title, lead, trail, *content = NULL;
+	int has_link, has_title, r = 0;
+
+	has_link = tree_getstr(rec, &link);
+	has_title = tree_getstr(rec, &title);
+	if (has_link < 0 || has_title < 0) {
+		w->status = MKD_ETREE;
+		return;
+	}
+
+	if (!tree_markup(w, rec, &lead, &trail))
+		return;
+
+	/* the parser hands no content over for an empty link text */
+	if (rec->size && (content = tree_inner(w, rec)) == NULL)
+		return;
+
+	if (w->cb->link && w->status == MKD_OK)
+		r = w->cb->link(ob, has_link ? &link : NULL, has_title ? &title : NULL,
+			content, w->opaque);
+
+	if (content)
+		tree_popbuf(w);
+
+	if (!r && w->status == MKD_OK && !(w->cb->link && lead.size == 0))
+		tree_verbatim(w, ob, rec, &lead, &trail);
+}
+
+/* tree_source • the rest of a leaf, its source past skip bytes, as text */
+static void
+tree_source(struct tree_walk *w, struct buf *ob, const struct tree_rec *rec, size_t skip)
+{
+	struct buf source = { (uint8_t *)rec->data + skip, rec->size - skip, 0, 0 };
+
+	tree_text(w, ob, &source);
+}
+
+/* tree_autolink • hands a link to the autolink callback, in a buffer of
+ * its own as from the parser */
+static int
+tree_autolink(struct tree_walk *w, struct buf *ob, const struct buf *text, enum mkd_autolink type)
+{
+	struct buf *link = tree_newbuf(w);
+	int r;
+
+	if (!link)
+		return 1;
+
+	bufput(link, text->data, text->size);
+	r = w->cb->autolink(ob, link, type, w->opaque);
+	tree_popbuf(w);
+	return r;
+}
+
+/* tree_leaf • renders a node without children */
+static void
+tree_leaf(struct tree_walk *w, struct buf *ob, struct tree_rec *rec)
+{
+	const struct sd_callbacks *cb = w->cb;
+	struct buf text, extra, alt;
+	int has_text = 0, has_extra = 0, has_alt = 0;
+	size_t rewind;
+
+	memset(&text, 0x0, sizeof(struct buf));
+	text.data = (uint8_t *)rec->data;
+	text.size = rec->size;
+
+	switch (rec->type) {
+	case MKDN_BLOCKCODE:
+		has_text = tree_getstr(rec, &text);
+		has_extra = tree_getstr(rec, &extra);
+		if (has_text < 0 || has_extra < 0)
+			break;
+
+		if (cb->blockcode)
+			cb->blockcode(ob, has_text ? &text : NULL, has_extra ? &extra : NULL, w->opaque);
+		return;
+
+	case MKDN_IMAGE:
+		has_extra = tree_getstr(rec, &extra);
+		has_text = tree_getstr(rec, &text);
+		has_alt = tree_getstr(rec, &alt);
+		if (has_extra < 0 || has_text < 0 || has_alt < 0)
+			break;
+
+		/* the '!' before the image, as the parser cuts it */
+		if (cb->image && ob->size && ob->data[ob->size - 1] == '!')
+			ob->size--;
+
+		if (cb->image && cb->image(ob, has_extra ? &extra : NULL,
+				has_text ? &text : NULL, has_alt ? &alt : NULL, w->opaque))
+			return;
+
+		tree_source(w, ob, rec, 0);
+		return;
+
+	case MKDN_AUTOLINK:
+		if (rec->size < 4)
+			break;
+
+		rewind = tree_get32(rec->data);
+		rec->data += 4;
+		rec->size -= 4;
+		if (tree_getstr(rec, &text) < 1 || rewind > rec->size)
+			break;
+
+		/* between angle brackets, it is a tag to the parser without
+		 * the callback, and text when refused */
+		if (rec->size && rec->data[0] == '<') {
+			struct buf tag = { (uint8_t *)rec->data, rec->size, 0, 0 };
+
+			if (cb->autolink) {
+				if (tree_autolink(w, ob, &text, (enum mkd_autolink)rec->arg))
+					return;
+			} else if (cb->raw_html_tag && cb->raw_html_tag(ob, &tag, w->opaque)) {
+				return;
+			}
+
+			tree_source(w, ob, rec, 0);
+			return;
+		}
+
+		/* the start of the link was written as text before it: it
+		 * goes with the link, refused or not, as in the parser */
+		if (cb->autolink) {
+			ob->size -= rewind < ob->size ? rewind : ob->size;
+			tree_autolink(w, ob, &text, (enum mkd_autolink)rec->arg);
+			return;
+		}
+
+		tree_source(w, ob, rec, rewind);
+		return;
+
+	case MKDN_LINEBREAK:
+		if (cb->linebreak) {
+			while (ob->size && ob->data[ob->size - 1] == ' ')
+				ob->size--;
+			if (cb->linebreak(ob, w->opaque))
+				return;
+		}
+
+		text.data = (uint8_t *)"\n";
+		text.size = 1;
+		tree_text(w, ob, &text);
+		return;
+
+	case MKDN_HRULE:
+		if (cb->hrule)
+			cb->hrule(ob, w->opaque);
+		return;
+
+	case MKDN_BLOCKHTML:
+		if (cb->blockhtml)
+			cb->blockhtml(ob, &text, w->opaque);
+		return;
+
+	case MKDN_CODESPAN:
+		has_text = tree_getstr(rec, &text);
+		if (has_text < 0)
+			break;
+
+		if (cb->codespan && cb->codespan(ob, has_text ? &text : NULL, w->opaque))
+			return;
+
+		tree_source(w, ob, rec, 0);
+		return;
+
+	case MKDN_RAW_HTML:
+		if (!cb->raw_html_tag || !cb->raw_html_tag(ob, &text, w->opaque))
+			tree_text(w, ob, &text);
+		return;
+
+	case MKDN_ENTITY:
+		if (cb->entity)
+			cb->entity(ob, &text, w->opaque);
+		else
+			bufput(ob, text.data, text.size);
+		return;
+
+	case MKDN_TEXT:
+		tree_text(w, ob, &text);
+		return;
+
+	default:
+		break;
+	}
+
+	w->status = MKD_ETREE;
+}
+
+/* tree_node • renders a record through its callback */
+static void
+tree_node(struct tree_walk *w, struct buf *ob, struct tree_rec *rec)
+{
+	const struct sd_callbacks *cb = w->cb;
+	struct buf *work;
+
+	if (rec->type >= MKDN_BLOCKCODE) {
+		tree_leaf(w, ob, rec);
+		return;
+	}
+
+	switch (rec->type) {
+	case MKDN_TABLE:
+		tree_table(w, ob, rec);
+		return;
+
+	case MKDN_TABLE_HEADER:
+	case MKDN_TABLE_BODY:
+		tree_nodes(w, ob, rec->data, rec->size);
+		return;
+
+	case MKDN_LINK:
+		tree_link(w, ob, rec);
+		return;
+
+	case MKDN_DOUBLE_EMPHASIS:
+		tree_span(w, ob, rec, cb->double_emphasis);
+		return;
+
+	case MKDN_EMPHASIS:
+		tree_span(w, ob, rec, cb->emphasis);
+		return;
+
+	case MKDN_TRIPLE_EMPHASIS:
+		tree_span(w, ob, rec, cb->triple_emphasis);
+		return;
+
+	case MKDN_STRIKETHROUGH:
+		tree_span(w, ob, rec, cb->strikethrough);
+		return;
+
+	case MKDN_SUPERSCRIPT:
+		tree_span(w, ob, rec, cb->superscript);
+		return;
+
+	default:
+		break;
+	}
+
+	/* blocks render their children even without a callback, as the
+	 * parser does: the callbacks may count them */
+	if ((work = tree_inner(w, rec)) == NULL)
+		return;
+
+	if (w->status == MKD_OK) {
+		switch (rec->type) {
+		case MKDN_BLOCKQUOTE:
+			if (cb->blockquote)
+				cb->blockquote(ob, work, w->opaque);
+			break;
+
+		case MKDN_HEADER:
+			if (cb->header)
+				cb->header(ob, work, rec->arg, w->opaque);
+			break;
+
+		case MKDN_LIST:
+			if (cb->list)
+				cb->list(ob, work, rec->arg, w->opaque);
+			break;
+
+		case MKDN_LISTITEM:
+			if (cb->listitem)
+				cb->listitem(ob, work, rec->arg, w->opaque);
+			break;
+
+		case MKDN_PARAGRAPH:
+			if (cb->paragraph)
+				cb->paragraph(ob, work, w->opaque);
+			break;
+
+		case MKDN_TABLE_ROW:
+			if (cb->table_row)
+				cb->table_row(ob, work, w->opaque);
+			break;
+
+		case MKDN_TABLE_CELL:
+			if (cb->table_cell)
+				cb->table_cell(ob, work, rec->arg, w->opaque);
+			break;
+
+		default:
+			w->status = MKD_ETREE;
+			break;
+		}
+	}
+
+	tree_popbuf(w);
+}
+
+/* tree_nodes • renders the records of data one after the other */
+static void
+tree_nodes(struct tree_walk *w, struct buf *ob, const uint8_t *data, size_t size)
+{
+	struct tree_rec rec;
+	size_t i = 0, used;
+
+	if (++w->depth > TREE_MAX_DEPTH)
+		w->status = MKD_ETREE;
+
+	while (i < size && w->status == MKD_OK) {
+		used = tree_record(data + i, size - i, &rec);
+		if (!used) {
+			w->status = MKD_ETREE;
+			break;
+		}
+
+		tree_node(w, ob, &rec);
+		i += used;
+	}
+
+	w->depth--;
+}
+
+void
+sd_tree_events(struct sd_events *events, unsigned int skip)
+{
+	memset(events, 0x0, sizeof(struct sd_events));
+	events->enter = tree_enter;
+	events->leave = tree_leave;
+	events->skip = skip;
+}
+
+int
+sd_tree_render(struct buf *ob, const uint8_t *tree, size_t tree_size,
+	const struct sd_callbacks *callbacks, void *opaque)
+{
+	struct tree_walk w;
+	size_t i;
+
+	if (tree_size < sizeof(tree_magic) || memcmp(tree, tree_magic, sizeof(tree_magic)) != 0)
+		return MKD_ETREE;
+
+	memset(&w, 0x0, sizeof(struct tree_walk));
+	w.cb = callbacks;
+	w.opaque = opaque;
+	w.status = MKD_OK;
+
+	if (stack_init(&w.work_bufs, 8) < 0)
+		return MKD_ENOMEM;
+
+	if (callbacks->doc_header)
+		callbacks->doc_header(ob, opaque);
+
+	tree_nodes(&w, ob, tree + sizeof(tree_magic), tree_size - sizeof(tree_magic));
+
+	if (callbacks->doc_footer && w.status == MKD_OK)
+		callbacks->doc_footer(ob, opaque);
+
+	for (i = 0; i < w.work_bufs.asize; ++i)
+		bufrelease(w.work_bufs.item[i]);
+
+	stack_free(&w.work_bufs);
+	return w.status;
+}
+
+/* vim: set filetype=c: */
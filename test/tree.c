@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2026, agent
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* tree • documents rendered to HTML from their text and from a tree */
+/*	with and without HTML_SAFELINK, so that spans the renderer refuses
+ *	come out of the tree as they do out of the parser; exits 1 on the
+ *	first document where the two differ */
+
+#include "markdown.h"
+#include "html.h"
+#include "buffer.h"
+#include "../bench/bench.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define EXTENSIONS (MKDEXT_TABLES | MKDEXT_FENCED_CODE | \
+	MKDEXT_AUTOLINK | MKDEXT_STRIKETHROUGH | MKDEXT_SPACE_HEADERS | \
+	MKDEXT_SUPERSCRIPT | MKDEXT_LAX_SPACING)
+
+static const char *cases[] = {
+	"[x](javascript:alert(1)) after\n",
+	"[*a* and **b**](javascript:x \"title\") after\n",
+	"[ref][r] and [r]\n\n[r]: vbscript:x\n",
+	"![img](javascript:x) and ![a]()\n",
+	"[]() and [a]() and [](/b)\n",
+	"<javascript:x> <http://a.b> <a@b.c> <mailto:a@b.c>\n",
+	"http://a.b/c www.a.b a@b.c javascript:x\n",
+	"`code` and `` `ticks` `` and `unclosed\n",
+	"x^(up) and ^sup and ^[x](javascript:x)\n",
+	"~~[del](javascript:x)~~ *[em](javascript:x)* ***[strong](vbscript:x)***\n",
+	"# [head](javascript:x)\n\n| a | [b](javascript:x) |\n|---|---|\n| `c` | d |\n",
+	"- [item](javascript:x)\n- ![i](/i.png)\n\n> [quote](javascript:x)\n",
+};
+
+static unsigned int flags[] = { 0, HTML_SAFELINK, HTML_SAFELINK | HTML_ESCAPE };
+
+/* check • renders doc both ways under each of the flags */
+static int
+check(const char *name, const uint8_t *doc, size_t size)
+{
+	struct sd_callbacks callbacks;
+	struct html_renderopt options;
+	struct sd_events events;
+	struct sd_config *cfg;
+	struct sd_markdown *md, *tree_md;
+	struct buf *direct, *tree, *check;
+	size_t i;
+	int ok = 1;
+
+	direct = bufnew(1024);
+	tree = bufnew(1024);
+	check = bufnew(1024);
+
+	for (i = 0; ok && i < sizeof(flags) / sizeof(flags[0]); ++i) {
+		sdhtml_renderer(&callbacks, &options, flags[i]);
+		md = sd_markdown_new(EXTENSIONS, 16, &callbacks, &options);
+		direct->size = 0;
+		sd_markdown_render(direct, doc, size, md);
+		sd_markdown_free(md);
+
+		sdhtml_events(&events, &options, flags[i]);
+		sd_tree_events(&events, events.skip);
+		cfg = sd_config_new_events(EXTENSIONS, 16, &events);
+		tree_md = sd_markdown_new_context(cfg, NULL);
+		tree->size = check->size = 0;
+		sd_markdown_render(tree, doc, size, tree_md);
+		sd_markdown_free(tree_md);
+		sd_config_free(cfg);
+
+		sdhtml_renderer(&callbacks, &options, flags[i]);
+		if (sd_tree_render(check, tree->data, tree->size, &callbacks, &options) != MKD_OK ||
+				check->size != direct->size ||
+				memcmp(check->data, direct->data, direct->size) != 0) {
+			printf("%s, flags 0x%x: the tree renders\n%.*s\ninstead of\n%.*s\n",
+				name, flags[i], (int)check->size, check->data,
+				(int)direct->size, direct->data);
+			ok = 0;
+		}
+	}
+
+	bufrelease(direct);
+	bufrelease(tree);
+	bufrelease(check);
+	return ok;
+}
+
+int
+main(void)
+{
+	struct buf *doc = bufnew(64 * 1024);
+	char name[32];
+	size_t i;
+	int ok = 1;
+
+	for (i = 0; ok && i < sizeof(cases) / sizeof(cases[0]); ++i) {
+		snprintf(name, sizeof(name), "case %zu", i + 1);
+		ok = check(name, (const uint8_t *)cases[i], strlen(cases[i]));
+	}
+
+	if (ok) {
+		put_links(doc, 256 * 1024);
+		ok = check("links", doc->data, doc->size);
+	}
+
+	if (ok) {
+		doc->size = 0;
+		put_manual(doc, 256 * 1024);
+		ok = check("manual", doc->data, doc->size);
+	}
+
+	bufrelease(doc);
+	if (ok)
+		printf("tree renders match\n");
+	return ok ? 0 : 1;
+}
+
+/* vim: set filetype=c: */